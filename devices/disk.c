@@ -48,6 +48,9 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors one READ or WRITE SECTOR command can transfer. */
+#define MAX_XFER_SECTORS 256
+
 /* An ATA device. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
@@ -84,7 +87,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -209,47 +212,99 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
+	disk_readv (d, sec_no, &buffer, 1, 1);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_writev (d, sec_no, &buffer, 1, 1);
+}
+
+/* Reads BUF_CNT * BUF_SECTORS consecutive sectors starting at
+   SEC_NO from disk D, BUF_SECTORS sectors into each of BUFS[0],
+   BUFS[1], ..., in order.
+   Issues one command per MAX_XFER_SECTORS sectors, rather than
+   one per sector as a disk_read() per sector would.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_readv (struct disk *d, disk_sector_t sec_no, void *const bufs[],
+		size_t buf_cnt, size_t buf_sectors) {
+	size_t cnt = buf_cnt * buf_sectors;
 	struct channel *c;
+	size_t i = 0;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (bufs != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
+	while (i < cnt) {
+		size_t xfer_end = i + (cnt - i < MAX_XFER_SECTORS
+				? cnt - i : MAX_XFER_SECTORS);
+
+		select_sector (d, sec_no + i, xfer_end - i);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		for (; i < xfer_end; i++) {
+			/* The disk interrupts as each sector becomes ready. */
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu,
+						d->name, sec_no + (disk_sector_t) i);
+			input_sector (c, (uint8_t *) bufs[i / buf_sectors]
+					+ i % buf_sectors * DISK_SECTOR_SIZE);
+			d->read_cnt++;
+		}
+	}
 	lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+/* Writes BUF_CNT * BUF_SECTORS consecutive sectors starting at
+   SEC_NO to disk D, BUF_SECTORS sectors from each of BUFS[0],
+   BUFS[1], ..., in order.  Returns after the disk has
    acknowledged receiving the data.
+   Issues one command per MAX_XFER_SECTORS sectors, rather than
+   one per sector as a disk_write() per sector would.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
-disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+disk_writev (struct disk *d, disk_sector_t sec_no, const void *const bufs[],
+		size_t buf_cnt, size_t buf_sectors) {
+	size_t cnt = buf_cnt * buf_sectors;
 	struct channel *c;
+	size_t i = 0;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (bufs != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	while (i < cnt) {
+		size_t xfer_end = i + (cnt - i < MAX_XFER_SECTORS
+				? cnt - i : MAX_XFER_SECTORS);
+
+		select_sector (d, sec_no + i, xfer_end - i);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		for (; i < xfer_end; i++) {
+			/* The disk asks for each sector in turn, and
+			   interrupts once it has taken it in. */
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu,
+						d->name, sec_no + (disk_sector_t) i);
+			output_sector (c, (const uint8_t *) bufs[i / buf_sectors]
+					+ i % buf_sectors * DISK_SECTOR_SIZE);
+			sema_down (&c->completion_wait);
+			d->write_cnt++;
+		}
+	}
 	lock_release (&c->lock);
 }
-
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -402,17 +457,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection registers,
+   to transfer sectors SEC_NO through SEC_NO + CNT - 1.  (We use
+   LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
+	ASSERT (cnt >= 1 && cnt <= MAX_XFER_SECTORS);
+	ASSERT (sec_no + cnt <= d->capacity);
 	ASSERT (sec_no < (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt);    /* 256 is written as 0. */
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
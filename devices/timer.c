@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,14 +18,39 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* Number of timer ticks since OS booted.  Written only with
+   interrupts off, under ticks_seq. */
 static int64_t ticks;
+static struct seqlock ticks_seq;
+
+/* Number of CPU cycles spent in the timer interrupt handler. */
+static uint64_t intr_cycles;
+
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the PIT count of one timer tick. */
+#define PIT_TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot interval, in timer ticks, that fits in the
+   PIT's 16-bit counter. */
+#define TICKLESS_MAX_TICKS (0xffff / PIT_TICK_COUNT)
+
+/* If true, the idle thread programs the PIT for the next timer
+   deadline instead of taking every periodic tick.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Number of ticks covered by the pending one-shot interval, or 0
+   if the PIT is in periodic mode. */
+static int64_t oneshot_ticks;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static void timer_tick (void);
+static void pit_set_periodic (void);
+static void pit_set_oneshot (int64_t ticks);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -34,14 +60,8 @@ static void real_time_sleep (int64_t num, int32_t denom);
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
-
+	seqlock_init (&ticks_seq);
+	pit_set_periodic ();
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -73,10 +93,13 @@ timer_calibrate (void) {
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) {
-	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
-	intr_set_level (old_level);
-	barrier ();
+	unsigned seq;
+	int64_t t;
+
+	do {
+		seq = seqlock_read_begin (&ticks_seq);
+		t = ticks;
+	} while (seqlock_read_retry (&ticks_seq, seq));
 	return t;
 }
 
@@ -117,16 +140,101 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Returns the number of CPU cycles spent in the timer interrupt
+   handler since the OS booted. */
+uint64_t
+timer_interrupt_cycles (void) {
+	enum intr_level old_level = intr_disable ();
+	uint64_t c = intr_cycles;
+	intr_set_level (old_level);
+	return c;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
-	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	int64_t t = timer_ticks ();
+
+	printf ("Timer: %"PRId64" ticks, %"PRIu64" interrupt cycles/tick\n",
+			t, t > 0 ? timer_interrupt_cycles () / t : 0);
 }
 
+/* Halts the CPU until the next interrupt, like the idle thread's
+   "sti; hlt", but in tickless mode first reprograms the PIT to
+   fire only at the next tick on which a sleeping thread may be
+   due, up to TICKLESS_MAX_TICKS ticks away.  Must be called with
+   interrupts off; returns with interrupts off.
+
+   If an interrupt other than the timer ends the halt early, the
+   whole ticks that passed are accounted for here and the PIT goes
+   back to periodic mode, so at most a fraction of a tick is lost
+   per early wake-up. */
+void
+timer_idle (void) {
+	int64_t n;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!intr_context ());
+
+	n = thread_next_wakeup (ticks + TICKLESS_MAX_TICKS) - ticks;
+	if (n > 1)
+		pit_set_oneshot (n);
+
+	/* See idle() in threads/thread.c for why these two
+	   instructions must go together. */
+	asm volatile ("sti; hlt" : : : "memory");
+	intr_disable ();
+
+	if (oneshot_ticks > 0) {
+		/* Latch and read counter 0. */
+		uint16_t remaining;
+		int64_t elapsed;
+
+		outb (0x43, 0x00);
+		remaining = inb (0x40);
+		remaining |= inb (0x40) << 8;
+
+		/* Once the count passes zero the counter wraps around and
+		   the timer interrupt is pending; it will account for the
+		   last tick itself. */
+		elapsed = (oneshot_ticks * PIT_TICK_COUNT - remaining) / PIT_TICK_COUNT;
+		if (remaining > oneshot_ticks * PIT_TICK_COUNT || elapsed >= oneshot_ticks)
+			elapsed = oneshot_ticks - 1;
+
+		oneshot_ticks = 0;
+		pit_set_periodic ();
+		while (elapsed-- > 0)
+			timer_tick ();
+	}
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	uint64_t start = rdtsc ();
+	int64_t n = 1;
+
+	/* A one-shot interval programmed by timer_idle() expired:
+	   account for every tick it covered. */
+	if (oneshot_ticks > 0) {
+		n = oneshot_ticks;
+		oneshot_ticks = 0;
+		pit_set_periodic ();
+	}
+
+	while (n-- > 0)
+		timer_tick ();
+	intr_cycles += rdtsc () - start;
+}
+
+/* Advances the tick count by one and does the per-tick work of
+   the scheduler.  Runs with interrupts off, normally in the timer
+   interrupt handler. */
+static void
+timer_tick (void) {
+	seqlock_write_begin (&ticks_seq);
 	ticks++;
+	seqlock_write_end (&ticks_seq);
 	thread_tick ();
 
 	/* For Advanced Scheduler */
@@ -145,6 +253,27 @@ timer_interrupt (struct intr_frame *args UNUSED) {
 	thread_awake (ticks);
 }
 
+/* Sets up the PIT to interrupt TIMER_FREQ times per second. */
+static void
+pit_set_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, PIT_TICK_COUNT & 0xff);
+	outb (0x40, PIT_TICK_COUNT >> 8);
+}
+
+/* Sets up the PIT to interrupt once, TICK_CNT timer ticks from
+   now. */
+static void
+pit_set_oneshot (int64_t tick_cnt) {
+	uint16_t count = tick_cnt * PIT_TICK_COUNT;
+
+	ASSERT (tick_cnt > 0 && tick_cnt <= TICKLESS_MAX_TICKS);
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+	oneshot_ticks = tick_cnt;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
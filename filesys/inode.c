@@ -8,6 +8,8 @@
 #include "filesys/free-map.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -73,10 +75,16 @@ byte_to_cluster (const struct inode *inode, off_t pos) {
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache for struct inode. */
+static struct slab_cache *inode_slab;
+
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	inode_slab = slab_cache_create ("inode", sizeof (struct inode), NULL);
+	if (inode_slab == NULL)
+		PANIC ("inode_init: out of memory");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -158,7 +166,7 @@ inode_open (cluster_t clst) {
 	}
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = slab_alloc (inode_slab);
 	if (inode == NULL)
 		return NULL;
 
@@ -208,7 +216,7 @@ inode_close (struct inode *inode) {
 			fat_remove_chain (inode->clst, 0);
 		}
 
-		free (inode); 
+		slab_free (inode_slab, inode);
 	}
 }
 
@@ -220,6 +228,25 @@ inode_remove (struct inode *inode) {
 	inode->removed = true;
 }
 
+/* Returns the number of sectors, starting with the one CLUSTER
+ * maps to and at most MAX_CNT, that follow it consecutively both
+ * in CLUSTER's chain and on disk, so that they can be read in one
+ * transfer. */
+static off_t
+sector_run (cluster_t cluster, off_t max_cnt) {
+	disk_sector_t first = cluster_to_sector (cluster);
+	off_t run = 1;
+
+	while (run < max_cnt) {
+		cluster_t next = fat_get (cluster);
+		if (cluster_to_sector (next) != first + run)
+			break;
+		cluster = next;
+		run++;
+	}
+	return run;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
  * than SIZE if an error occurs or end of file is reached. */
@@ -246,8 +273,15 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, cluster_to_sector (cluster_idx), buffer + bytes_read); 
+			/* Read full sectors directly into caller's buffer, as
+			 * many as lie consecutively on disk in one transfer. */
+			disk_sector_t first = cluster_to_sector (cluster_idx);
+			void *dst = buffer + bytes_read;
+			off_t run = sector_run (cluster_idx,
+					(size < inode_left ? size : inode_left) / DISK_SECTOR_SIZE);
+
+			disk_readv (filesys_disk, first, &dst, 1, run);
+			chunk_size = run * DISK_SECTOR_SIZE;
 		} else {
 			/* Read sector into bounce buffer, then partially copy
 			 * into caller's buffer. */
@@ -270,6 +304,73 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	return bytes_read;
 }
 
+/* Reads SIZE bytes from INODE, starting at position OFFSET, which
+ * must be a multiple of DISK_SECTOR_SIZE, into the PAGE_CNT pages
+ * PAGES[0], PAGES[1], ..., PGSIZE bytes into each, in order.
+ * Sectors that lie consecutively on disk go to whole pages in a
+ * single transfer.  Returns the number of bytes actually read,
+ * which may be less than SIZE if an error occurs or end of file
+ * is reached. */
+off_t
+inode_read_pages (struct inode *inode, void *const pages[], size_t page_cnt,
+		off_t size, off_t offset) {
+	const size_t sectors_per_page = PGSIZE / DISK_SECTOR_SIZE;
+	off_t bytes_read = 0;
+
+	ASSERT (offset % DISK_SECTOR_SIZE == 0);
+	ASSERT ((size_t) size <= page_cnt * PGSIZE);
+
+	while (size > 0) {
+		off_t inode_left = inode_length (inode) - offset;
+		off_t left = size < inode_left ? size : inode_left;
+		disk_sector_t first;
+		off_t run, done;
+
+		if (left <= 0)
+			break;
+		if (left < DISK_SECTOR_SIZE) {
+			/* The last, partial sector. */
+			bytes_read += inode_read_at (inode,
+					(uint8_t *) pages[bytes_read / PGSIZE] + bytes_read % PGSIZE,
+					left, offset);
+			break;
+		}
+
+		first = cluster_to_sector (byte_to_cluster (inode, offset));
+		run = sector_run (byte_to_cluster (inode, offset),
+				left / DISK_SECTOR_SIZE);
+
+		/* Read the run's whole pages together, and the sectors of
+		 * a page it starts or ends partway through on their own. */
+		for (done = 0; done < run; ) {
+			off_t pos = bytes_read + done * DISK_SECTOR_SIZE;
+			size_t page_ofs = pos % PGSIZE;
+			size_t cnt;
+
+			if (page_ofs == 0 && (size_t) (run - done) >= sectors_per_page) {
+				cnt = (run - done) / sectors_per_page;
+				disk_readv (filesys_disk, first + done, &pages[pos / PGSIZE],
+						cnt, sectors_per_page);
+				cnt *= sectors_per_page;
+			} else {
+				void *dst = (uint8_t *) pages[pos / PGSIZE] + page_ofs;
+
+				cnt = (PGSIZE - page_ofs) / DISK_SECTOR_SIZE;
+				if (cnt > (size_t) (run - done))
+					cnt = run - done;
+				disk_readv (filesys_disk, first + done, &dst, 1, cnt);
+			}
+			done += cnt;
+		}
+
+		size -= run * DISK_SECTOR_SIZE;
+		offset += run * DISK_SECTOR_SIZE;
+		bytes_read += run * DISK_SECTOR_SIZE;
+	}
+
+	return bytes_read;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
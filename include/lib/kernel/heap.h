@@ -0,0 +1,68 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Pairing heap.
+ *
+ * A priority queue that, like our lists, needs no dynamically
+ * allocated memory: each structure that is a potential heap
+ * element must embed a struct heap_elem member, and heap_entry()
+ * converts a struct heap_elem back to the structure that
+ * contains it.  An element may be in at most one heap at a time
+ * through a given struct heap_elem.
+ *
+ * The heap is ordered by a heap_less_func supplied to
+ * heap_init(), and heap_top() returns a greatest element, so with
+ * the usual "less than" comparison this is a max-heap.  Elements
+ * that compare equal come out in no particular order.
+ *
+ * heap_push() and heap_top() take constant time, and heap_pop(),
+ * heap_remove() and heap_update() take O(log n) amortized time.
+ * When an element's key changes, heap_update() must be called to
+ * restore the heap order before any other operation on the heap. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem {
+	struct heap_elem *child;    /* First child. */
+	struct heap_elem *next;     /* Next sibling. */
+	struct heap_elem *prev;     /* Previous sibling, or parent. */
+};
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap {
+	struct heap_elem *root;     /* Greatest element, or null. */
+	size_t size;                /* Number of elements. */
+	heap_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+		- offsetof (STRUCT, MEMBER.child)))
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_top (const struct heap *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+bool heap_empty (const struct heap *);
+size_t heap_size (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
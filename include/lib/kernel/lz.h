@@ -0,0 +1,31 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* LZ77-class compression, in the manner of LZ4.
+ *
+ * Fast rather than thorough: the compressor finds matches through
+ * a single hash table of recent positions and never looks back
+ * further than 64 kB, and the decompressor is a simple byte copy
+ * loop.  Suits page-sized blocks of in-memory data.
+ *
+ * lz_compress() needs LZ_WORK_SIZE bytes of scratch memory from
+ * the caller.  Its contents between calls do not matter, so one
+ * buffer may be reused without being cleared, as long as calls do
+ * not overlap. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZ_HASH_BITS 12
+#define LZ_WORK_SIZE (sizeof (uint16_t) << LZ_HASH_BITS)
+
+/* Largest block lz_compress() accepts. */
+#define LZ_MAX_BLOCK 65536
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, void *work);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
@@ -0,0 +1,49 @@
+#ifndef __LIB_SCHEDSTAT_H
+#define __LIB_SCHEDSTAT_H
+
+#include <stdint.h>
+
+/* Scheduler latency statistics, shared between the kernel and
+   user programs through the sched_stats() system call.
+
+   All times are in CPU cycles as counted by the time-stamp
+   counter.  Bucket B of a histogram counts the samples of
+   2**B up to 2**(B+1) - 1 cycles; the last bucket also counts
+   everything longer. */
+#define SCHEDSTAT_BUCKETS 32
+
+/* Log2-bucketed histogram of durations. */
+struct sched_hist {
+	uint32_t buckets[SCHEDSTAT_BUCKETS];
+	uint64_t cnt;               /* Number of samples. */
+	uint64_t sum;               /* Sum of samples. */
+	uint64_t max;               /* Longest sample. */
+};
+
+/* Statistics for the threads of one priority level. */
+struct sched_prio_stats {
+	struct sched_hist wakeup;   /* From thread_unblock() to running. */
+	struct sched_hist runnable; /* From any ready state to running. */
+	struct sched_hist slice;    /* From running to switched out. */
+	uint64_t voluntary;         /* Switches out by blocking or yielding. */
+	uint64_t involuntary;       /* Switches out by preemption. */
+};
+
+/* Statistics for one thread, kept small since they live in
+   struct thread. */
+struct sched_thread_stats {
+	uint64_t wakeup_cnt;        /* Number of wakeups. */
+	uint64_t wakeup_sum;        /* Total wakeup latency. */
+	uint64_t wakeup_max;        /* Longest wakeup latency. */
+	uint64_t run_sum;           /* Total time spent running. */
+	uint64_t voluntary;         /* Switches out by blocking or yielding. */
+	uint64_t involuntary;       /* Switches out by preemption. */
+};
+
+/* What sched_stats() reports. */
+struct sched_stats {
+	struct sched_thread_stats thread;   /* The calling thread. */
+	struct sched_prio_stats prio;       /* The requested priority. */
+};
+
+#endif /* lib/schedstat.h */
@@ -36,6 +36,9 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Scheduler statistics. */
+	SYS_SCHED_STATS,            /* Report scheduler latency statistics. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -1,68 +1,61 @@
-/* For Fixed-Point Arithmetic */
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+/* For Fixed-Point Arithmetic
+ *
+ * 17.14 fixed-point numbers stored in an int.  X and Y are
+ * fixed-point numbers, N is an integer.  Products and quotients
+ * of two fixed-point numbers go through 64-bit intermediates so
+ * they do not overflow.  Everything is inlined, since these run
+ * in the timer interrupt handler for the MLFQS. */
 #include <stdint.h>
 
 #define Q 14
 #define F (1<<14)
 
-int convert_n_to_fp (int n);
-int convert_x_to_int (int x);
-int convert_x_to_int_round (int x);
-
-int add_x_and_y (int x, int y);
-int add_x_and_n (int x, int n);
-
-int sub_y_from_x (int x, int y);
-int sub_n_from_x (int x, int n);
-
-int mul_x_by_y (int x, int y);
-int mul_x_by_n (int x, int n);
-
-int div_x_by_y (int x, int y);
-int div_x_by_n (int x, int n);
-
-/* 이런 방식으로 쭉 구현하셈 */
-
-int convert_n_to_fp (int n) {
+static inline int convert_n_to_fp (int n) {
     return n * F;
 }
 
-int convert_x_to_int (int x) {
+static inline int convert_x_to_int (int x) {
     return x / F;
 }
 
-int convert_x_to_int_round (int x) {
+static inline int convert_x_to_int_round (int x) {
     if (x >= 0) return (x + (F / 2)) / F;
     return (x - (F / 2)) / F;
 }
 
-int add_x_and_y (int x, int y) {
+static inline int add_x_and_y (int x, int y) {
     return x + y;
 }
 
-int sub_y_from_x (int x, int y) {
+static inline int sub_y_from_x (int x, int y) {
     return x - y;
 }
 
-int add_x_and_n (int x, int n) {
+static inline int add_x_and_n (int x, int n) {
     return x + (n * F);
 }
 
-int sub_n_from_x (int x, int n) {
+static inline int sub_n_from_x (int x, int n) {
     return x - (n * F);
 }
 
-int mul_x_by_y (int x, int y) {
+static inline int mul_x_by_y (int x, int y) {
     return ((int64_t) x) * y / F;
 }
 
-int mul_x_by_n (int x, int n) {
+static inline int mul_x_by_n (int x, int n) {
     return x * n;
 }
 
-int div_x_by_y (int x, int y) {
+static inline int div_x_by_y (int x, int y) {
     return ((int64_t) x) * F / y;
 }
 
-int div_x_by_n (int x, int n) {
+static inline int div_x_by_n (int x, int n) {
     return x / n;
-}
\ No newline at end of file
+}
+
+#endif /* threads/fixed_point.h */
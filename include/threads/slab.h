@@ -0,0 +1,20 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Slab cache of fixed-size objects. */
+struct slab_cache;
+
+/* Constructor run on each object when its slab is created. */
+typedef void slab_ctor_func (void *obj);
+
+void slab_init (void);
+struct slab_cache *slab_cache_create (const char *name, size_t size,
+		slab_ctor_func *);
+void slab_cache_destroy (struct slab_cache *);
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,30 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+/* switch_threads()'s stack frame.  Holds the callee-saved
+   registers of the System V AMD64 ABI, in the order in which
+   switch_threads() pushes them. */
+struct switch_threads_frame {
+	uint64_t r15;               /*  0: Saved %r15. */
+	uint64_t r14;               /*  8: Saved %r14. */
+	uint64_t r13;               /* 16: Saved %r13. */
+	uint64_t r12;               /* 24: Saved %r12. */
+	uint64_t rbx;               /* 32: Saved %rbx. */
+	uint64_t rbp;               /* 40: Saved %rbp. */
+	void (*rip) (void);         /* 48: Return address. */
+};
+
+/* Switches from CUR, which must be the running thread, to NEXT,
+   which must also be running switch_threads(). */
+void switch_threads (struct thread *cur, struct thread *next);
+
+/* Where a new thread first returns to from switch_threads().
+   Calls the function in the frame's %r14 with the arguments in
+   %r12 and %r13. */
+void switch_entry (void);
+#endif
+
+#endif /* threads/switch.h */
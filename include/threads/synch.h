@@ -1,13 +1,33 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Queue of threads blocked on a synchronization object, highest
+   priority first and first-come first-served among threads of
+   equal priority.  A thread's position follows changes in its
+   priority, such as by donation, while it waits. */
+struct wait_queue {
+	struct heap heap;           /* Waiting threads. */
+	uint64_t next_seq;          /* Arrival number for the next waiter. */
+};
+
+void wait_queue_init (struct wait_queue *);
+void wait_queue_push (struct wait_queue *, struct thread *);
+struct thread *wait_queue_pop (struct wait_queue *);
+void wait_queue_requeue (struct thread *);
+bool wait_queue_empty (const struct wait_queue *);
+size_t wait_queue_size (const struct wait_queue *);
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct wait_queue waiters;  /* Waiting threads. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -16,10 +36,20 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
-/* Lock. */
+/* Lock.
+
+   Unless the MLFQS is in use, threads waiting for a lock donate
+   their priority to its holder.  A lock keeps its waiters in a
+   max-heap by priority, and its holder keeps the locks it holds
+   in a max-heap by the highest priority waiting on them, so the
+   holder's priority is the greater of its own and that of the top
+   of the second heap. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct heap waiters;        /* Threads waiting, by priority. */
+	int priority;               /* Highest waiter priority, or -1. */
+	struct heap_elem holder_elem; /* Element in holder's held_locks. */
 };
 
 void lock_init (struct lock *);
@@ -28,9 +58,50 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Reader-writer lock.
+
+   Any number of readers or a single writer may hold it.  A writer
+   holds LOCK from the moment it starts to wait until it releases
+   the rwlock, so new readers queue up behind a waiting writer
+   (writer preference) and the threads waiting for the rwlock
+   donate their priority to the writer.  Waiters are woken in
+   priority order. */
+struct rwlock {
+	struct lock lock;           /* Held by the writer, briefly by readers. */
+	unsigned readers;           /* Number of readers holding the rwlock. */
+	bool writer_waiting;        /* Writer waiting for readers to leave? */
+	struct semaphore drained;   /* Upped when the last reader leaves. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
+/* Sequence lock.
+
+   For small records that are read much more often than written.
+   Readers never block writers: they read the record between
+   seqlock_read_begin() and seqlock_read_retry() and start over if
+   a write overlapped.  Writers must be serialized by some other
+   means, such as running with interrupts off, and a writer must
+   never be interrupted by a reader of the same record, since the
+   reader would wait for the write to end forever. */
+struct seqlock {
+	volatile unsigned seq;      /* Odd while a write is in progress. */
+};
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (const struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned start);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct wait_queue waiters;  /* Waiting threads. */
 };
 
 void cond_init (struct condition *);
@@ -38,7 +109,8 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-bool sema_priority_comparator (const struct list_elem *l, const struct list_elem *r, void *aux);
+bool lock_priority_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
 
 /* Optimization barrier.
  *
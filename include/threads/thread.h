@@ -3,6 +3,7 @@
 
 #include <debug.h>
 #include <list.h>
+#include <schedstat.h>
 #include <stdint.h>
 #include "threads/synch.h"
 #include "threads/interrupt.h"
@@ -108,15 +109,31 @@ struct thread {
 	struct lock *wait_on_lock;
 
 	/* For multiple donation */
-	struct list donations;
-	struct list_elem donation_elem;
+	struct heap held_locks;             /* Held locks, by donated priority. */
+	struct heap_elem donor_elem;        /* Element in wait_on_lock's waiters. */
 
 	/* For Advanced Scheduler */
 	int recent_cpu;
 	int nice;
+	bool mlfqs_active;                  /* On mlfqs_list? */
+	struct list_elem mlfqs_elem;        /* List element for mlfqs_list. */
+	bool mlfqs_stale;                   /* Priority needs recalculation? */
+	struct list_elem mlfqs_stale_elem;  /* List element for mlfqs_stale_list. */
+
+	struct list_elem all_elem;          /* List element for all threads list. */
+
+	/* Scheduler statistics. */
+	uint64_t ready_stamp;               /* TSC when last made ready. */
+	uint64_t run_stamp;                 /* TSC when last scheduled. */
+	bool woken;                         /* Made ready by thread_unblock()? */
+	bool preempted;                     /* Switching out by preemption? */
+	struct sched_thread_stats stats;
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
+	struct wait_queue *wait_queue;      /* Queue we are waiting in, if any. */
+	struct heap_elem wait_elem;         /* Element in wait_queue. */
+	uint64_t wait_seq;                  /* Arrival number in wait_queue. */
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -150,7 +167,7 @@ struct thread {
 #endif
 
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
+	uint8_t *stack;                     /* Saved stack pointer. */
 	unsigned magic;                     /* Detects stack overflow. */
 };
 
@@ -164,9 +181,11 @@ void thread_start (void);
 
 void thread_sleep (int64_t ticks);
 void thread_awake (int64_t ticks);
+int64_t thread_next_wakeup (int64_t limit);
 
 void thread_tick (void);
 void thread_print_stats (void);
+bool thread_get_sched_stats (int priority, struct sched_stats *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -178,20 +197,20 @@ struct thread *thread_current (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
 
+
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
 
+void thread_change_priority (struct thread *t, int priority);
 void check_priority (void);
 void check_donation (void);
+int thread_effective_priority (struct thread *t);
 
-bool thread_priority_comparator(const struct list_elem *a, const struct list_elem *b, void *aux);
-bool thread_donation_priority_comparator(const struct list_elem *a, const struct list_elem *b, void *aux);
 
 void update_recent_cpu (bool curr);
-void thread_update_recent_cpu (struct thread *t);
 void recalculate_priority (void);
 void thread_recalculate_priority (struct thread *t);
 void recalculate_load_avg (void);
@@ -33,6 +33,9 @@ bool isdir (int fd);
 int inumber (int fd);
 #endif
 
+struct sched_stats;
+bool sched_stats (int priority, struct sched_stats *);
+
 void check_address (void *addr);
 void check_buffer (void *buffer, unsigned size);
 struct file *get_file_with_fd (int fd);
@@ -4,6 +4,9 @@
 struct page;
 enum vm_type;
 
+/* Most pages written to or read from swap in one transfer. */
+#define SWAP_CLUSTER 8
+
 struct anon_page {
     int sector;
 };
@@ -12,5 +15,7 @@ struct bitmap *swap_table;
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_swap_share (struct page *page, const struct page *src);
+bool anon_swap_out_cluster (struct page *pages[], size_t cnt);
 
 #endif
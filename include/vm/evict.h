@@ -0,0 +1,42 @@
+#ifndef VM_EVICT_H
+#define VM_EVICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct frame;
+
+/* A page replacement policy.  It chooses victims among the frames
+ * on frame_list.  All of its functions are called with the frame
+ * table locked. */
+struct evict_policy {
+	const char *name;
+
+	/* FRAME was just added to the back of frame_list. */
+	void (*insert) (struct frame *frame);
+	/* FRAME is about to be removed from frame_list. */
+	void (*remove) (struct frame *frame);
+	/* Returns the frame to evict.  frame_list is not empty. */
+	struct frame *(*victim) (void);
+};
+
+/* Eviction and swap statistics. */
+struct evict_stats {
+	uint64_t evictions;         /* Frames evicted. */
+	uint64_t clean_evictions;   /* Of those, frames not written to. */
+	uint64_t swap_outs;         /* Pages written to swap. */
+	uint64_t swap_out_clusters; /* Disk transfers writing them. */
+	uint64_t swap_ins;          /* Pages read from swap. */
+	uint64_t readaheads;        /* Of those, pages read ahead. */
+	uint64_t file_writes;       /* Mapped pages written back to files. */
+};
+
+extern const struct evict_policy *evict_policy;
+extern struct evict_stats evict_stats;
+
+bool evict_set_policy (const char *name);
+bool frame_is_accessed (struct frame *);
+bool frame_is_dirty (struct frame *);
+void evict_print_stats (void);
+
+#endif /* vm/evict.h */
@@ -7,6 +7,7 @@ struct page;
 enum vm_type;
 
 struct file_page {
+	bool exec;                  /* Part of an executable (VM_EXEC)? */
 };
 
 void vm_file_init (void);
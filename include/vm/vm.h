@@ -37,6 +37,10 @@ struct thread;
 
 #define VM_TYPE(type) ((type) & 7)
 
+/* Marks a VM_FILE page holding a read-only part of an executable,
+ * which is never written back: see load_segment(). */
+#define VM_EXEC VM_MARKER_0
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -49,6 +53,9 @@ struct page {
 	/* Your implementation */
 	struct hash_elem hash_elem;
 	bool writable;
+	bool zero_mapped;           /* Mapped to the shared zero page. */
+	struct thread *owner;       /* Thread whose page table maps VA. */
+	struct list_elem rmap_elem; /* Element in frame's "pages" list. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -62,11 +69,25 @@ struct page {
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ * After fork, a frame may be shared copy-on-write by several pages,
+ * all mapping it read-only.  So may a frame holding a read-only page
+ * of an executable, by all the processes running it.  PAGES is the
+ * reverse map from the frame to them, and PAGE is one of them. */
 struct frame {
 	void *kva;
 	struct page *page;
+	struct list pages;          /* Pages mapping this frame. */
+	unsigned ref_cnt;           /* Number of pages on PAGES. */
+	bool evicting;              /* Being written out for eviction? */
+	uint8_t age;                /* Recent use history, for "lru". */
 	struct list_elem frame_elem;
+
+	/* Executable contents, if on the shared index. */
+	struct inode *inode;        /* Read from INODE... */
+	off_t ofs;                  /* ...at OFS... */
+	size_t read_bytes;          /* ...this many bytes, rest zeroed. */
+	struct hash_elem share_elem;
 };
 
 struct list frame_list;
@@ -92,6 +113,8 @@ struct page_operations {
  * All designs up to you for this. */
 struct supplemental_page_table {
 	struct hash hash_for_spt;
+	void *fault_next;           /* Page after the last fault-around. */
+	size_t fault_window;        /* Pages to bring in on a file fault. */
 };
 
 struct necessary_info {
@@ -125,6 +148,9 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+struct frame *vm_get_free_frame (void);
+bool vm_map_frame (struct page *page, struct frame *frame);
 enum vm_type page_get_type (struct page *page);
+void vm_print_stats (void);
 
 #endif  /* VM_VM_H */
@@ -0,0 +1,23 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct disk;
+
+/* Default for zswap_limit, in bytes. */
+#define ZSWAP_DEFAULT_LIMIT (1024 * 1024)
+
+/* Most bytes of compressed pages to keep in memory.  0 turns the
+ * compressed tier off. */
+extern size_t zswap_limit;
+
+void zswap_init (struct disk *swap_disk, size_t slot_cnt);
+bool zswap_store (size_t slot, const void *page);
+bool zswap_load (size_t slot, void *page);
+bool zswap_contains (size_t slot);
+void zswap_invalidate (size_t slot);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
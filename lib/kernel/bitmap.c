@@ -26,6 +26,7 @@ typedef unsigned long elem_type;
    simulates an array of bits. */
 struct bitmap {
 	size_t bit_cnt;     /* Number of bits. */
+	size_t cursor;      /* Where bitmap_scan_and_flip_next() starts. */
 	elem_type *bits;    /* Elements that represent bits. */
 };
 
@@ -55,6 +56,23 @@ byte_cnt (size_t bit_cnt) {
 	return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Returns an elem_type in which the CNT bits starting at bit
+   OFS are turned on.  OFS + CNT must be at most ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt) {
+	elem_type mask = cnt < ELEM_BITS ? ((elem_type) 1 << cnt) - 1 : (elem_type) -1;
+	return mask << ofs;
+}
+
+/* Returns the number of bits to examine in the element that
+   contains bit START, if examining the bits from START up to
+   END, exclusive. */
+static inline size_t
+span_in_elem (size_t start, size_t end) {
+	size_t left = ELEM_BITS - start % ELEM_BITS;
+	return end - start < left ? end - start : left;
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -74,6 +92,7 @@ bitmap_create (size_t bit_cnt) {
 	struct bitmap *b = malloc (sizeof *b);
 	if (b != NULL) {
 		b->bit_cnt = bit_cnt;
+		b->cursor = 0;
 		b->bits = malloc (byte_cnt (bit_cnt));
 		if (b->bits != NULL || bit_cnt == 0) {
 			bitmap_set_all (b, false);
@@ -94,6 +113,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED) {
 	ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
 	b->bit_cnt = bit_cnt;
+	b->cursor = 0;
 	b->bits = (elem_type *) (b + 1);
 	bitmap_set_all (b, false);
 	return b;
@@ -138,30 +158,38 @@ bitmap_set (struct bitmap *b, size_t idx, bool value) {
 		bitmap_reset (b, idx);
 }
 
-/* Atomically sets the bit numbered BIT_IDX in B to true. */
-void
-bitmap_mark (struct bitmap *b, size_t bit_idx) {
-	size_t idx = elem_idx (bit_idx);
-	elem_type mask = bit_mask (bit_idx);
-
+/* Atomically sets the bits in MASK in the element numbered IDX
+   in B to true. */
+static inline void
+elem_mark (struct bitmap *b, size_t idx, elem_type mask) {
 	/* This is equivalent to `b->bits[idx] |= mask' except that it
 	   is guaranteed to be atomic on a uniprocessor machine.  See
 	   the description of the OR instruction in [IA32-v2b]. */
 	asm ("lock orq %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
 }
 
-/* Atomically sets the bit numbered BIT_IDX in B to false. */
-void
-bitmap_reset (struct bitmap *b, size_t bit_idx) {
-	size_t idx = elem_idx (bit_idx);
-	elem_type mask = bit_mask (bit_idx);
-
+/* Atomically sets the bits in MASK in the element numbered IDX
+   in B to false. */
+static inline void
+elem_reset (struct bitmap *b, size_t idx, elem_type mask) {
 	/* This is equivalent to `b->bits[idx] &= ~mask' except that it
 	   is guaranteed to be atomic on a uniprocessor machine.  See
 	   the description of the AND instruction in [IA32-v2a]. */
 	asm ("lock andq %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
 }
 
+/* Atomically sets the bit numbered BIT_IDX in B to true. */
+void
+bitmap_mark (struct bitmap *b, size_t bit_idx) {
+	elem_mark (b, elem_idx (bit_idx), bit_mask (bit_idx));
+}
+
+/* Atomically sets the bit numbered BIT_IDX in B to false. */
+void
+bitmap_reset (struct bitmap *b, size_t bit_idx) {
+	elem_reset (b, elem_idx (bit_idx), bit_mask (bit_idx));
+}
+
 /* Atomically toggles the bit numbered IDX in B;
    that is, if it is true, makes it false,
    and if it is false, makes it true. */
@@ -194,33 +222,49 @@ bitmap_set_all (struct bitmap *b, bool value) {
 	bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically, but not the whole range. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		bitmap_set (b, start + i, value);
+	while (start < end) {
+		size_t n = span_in_elem (start, end);
+		elem_type mask = range_mask (start % ELEM_BITS, n);
+
+		if (value)
+			elem_mark (b, elem_idx (start), mask);
+		else
+			elem_reset (b, elem_idx (start), mask);
+		start += n;
+	}
 }
 
 /* Returns the number of bits in B between START and START + CNT,
    exclusive, that are set to VALUE. */
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i, value_cnt;
+	size_t end = start + cnt;
+	size_t value_cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
 	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
+	while (start < end) {
+		size_t n = span_in_elem (start, end);
+		elem_type bits = b->bits[elem_idx (start)];
+
+		if (!value)
+			bits = ~bits;
+		value_cnt += __builtin_popcountl (bits & range_mask (start % ELEM_BITS, n));
+		start += n;
+	}
 	return value_cnt;
 }
 
@@ -228,15 +272,22 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
+	while (start < end) {
+		size_t n = span_in_elem (start, end);
+		elem_type bits = b->bits[elem_idx (start)];
+
+		if (!value)
+			bits = ~bits;
+		if (bits & range_mask (start % ELEM_BITS, n))
 			return true;
+		start += n;
+	}
 	return false;
 }
 
@@ -263,21 +314,58 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or the size of B if there is none.  Skips
+   over whole elements that hold no such bit. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value) {
+	elem_type flip = value ? 0 : (elem_type) -1;
+	size_t idx, last_idx;
+	elem_type bits;
+
+	if (start >= b->bit_cnt)
+		return b->bit_cnt;
+
+	idx = elem_idx (start);
+	last_idx = elem_cnt (b->bit_cnt) - 1;
+	bits = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+	while (bits == 0) {
+		if (idx == last_idx)
+			return b->bit_cnt;
+		bits = b->bits[++idx] ^ flip;
+	}
+
+	/* The unused bits past the end of the last element may be
+	   anything once flipped, so clamp the result. */
+	start = idx * ELEM_BITS + __builtin_ctzl (bits);
+	return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Works an element at a time: it jumps to the next bit set to
+   VALUE, then to the next bit that is not, and checks whether
+   the run in between is long enough. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 0)
+		return start;
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
+		size_t i = start;
+
+		while ((i = next_bit (b, i, value)) <= last) {
+			size_t end = next_bit (b, i, !value);
+			if (end - i >= cnt)
 				return i;
+			i = end;
+		}
 	}
 	return BITMAP_ERROR;
 }
@@ -297,6 +385,25 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value) {
 	return idx;
 }
 
+/* Like bitmap_scan_and_flip(), but instead of a starting index,
+   starts just past the group found by the previous call to this
+   function on B, wrapping around to the start of B if needed.
+   Spreading successive searches over the bitmap this way keeps
+   them from rescanning the same used bits at its start. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value) {
+	size_t start = b->cursor <= b->bit_cnt ? b->cursor : 0;
+	size_t idx = bitmap_scan (b, start, cnt, value);
+
+	if (idx == BITMAP_ERROR && start > 0)
+		idx = bitmap_scan (b, 0, cnt, value);
+	if (idx != BITMAP_ERROR) {
+		bitmap_set_multiple (b, idx, cnt, !value);
+		b->cursor = idx + cnt;
+	}
+	return idx;
+}
+
 /* File input and output. */
 
 #ifdef FILESYS
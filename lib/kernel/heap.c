@@ -0,0 +1,178 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every node is greater than or
+   equal to its children, kept in "leftmost child, right sibling"
+   form: each node points to its first child and to its next
+   sibling.  Each node's `prev' points to its previous sibling, or
+   to its parent if it is a first child, so that any node can be
+   cut out of the tree in constant time.  The root has no parent
+   and no siblings.
+
+   Two trees are melded by making the lesser root the first child
+   of the greater one.  Popping the root melds its children pairwise
+   from left to right and then melds the results from right to
+   left, which is what gives the logarithmic amortized bound. */
+
+static struct heap_elem *meld (struct heap *,
+		struct heap_elem *, struct heap_elem *);
+static struct heap_elem *meld_pairs (struct heap *, struct heap_elem *);
+static void cut (struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->size = 0;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->next = elem->prev = NULL;
+	heap->root = heap->root != NULL ? meld (heap, heap->root, elem) : elem;
+	heap->size++;
+}
+
+/* Returns a greatest element in HEAP.
+   Undefined behavior if HEAP is empty. */
+struct heap_elem *
+heap_top (const struct heap *heap) {
+	ASSERT (!heap_empty (heap));
+	return heap->root;
+}
+
+/* Removes and returns a greatest element in HEAP.
+   Undefined behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop (struct heap *heap) {
+	struct heap_elem *top = heap_top (heap);
+
+	heap->root = meld_pairs (heap, top->child);
+	heap->size--;
+	top->child = NULL;
+	return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	struct heap_elem *sub;
+
+	ASSERT (!heap_empty (heap));
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root) {
+		heap_pop (heap);
+		return;
+	}
+
+	cut (elem);
+	sub = meld_pairs (heap, elem->child);
+	if (sub != NULL)
+		heap->root = meld (heap, heap->root, sub);
+	heap->size--;
+	elem->child = NULL;
+}
+
+/* Restores the heap order after the value of ELEM, which must be
+   in HEAP, changed. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem) {
+	heap_remove (heap, elem);
+	heap_push (heap, elem);
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root == NULL;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->size;
+}
+
+/* Melds the trees rooted at A and B, neither of which has
+   siblings, and returns the root of the result. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	ASSERT (a->next == NULL && a->prev == NULL);
+	ASSERT (b->next == NULL && b->prev == NULL);
+
+	if (heap->less (a, b, heap->aux)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	/* Make B the first child of A. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Melds the sibling list starting at FIRST into a single tree
+   and returns its root, or a null pointer if FIRST is null. */
+static struct heap_elem *
+meld_pairs (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* Left to right: meld siblings in pairs, stacking the results
+	   on PAIRS in reverse order. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL) {
+			b->next = b->prev = NULL;
+			a = meld (heap, a, b);
+		}
+		a->next = pairs;
+		pairs = a;
+	}
+
+	/* Right to left: meld the pairs into one tree. */
+	while (pairs != NULL) {
+		struct heap_elem *a = pairs;
+
+		pairs = a->next;
+		a->next = NULL;
+		root = root != NULL ? meld (heap, root, a) : a;
+	}
+	return root;
+}
+
+/* Detaches the subtree rooted at ELEM, which must not be the
+   root, from its parent and siblings. */
+static void
+cut (struct heap_elem *elem) {
+	ASSERT (elem->prev != NULL);
+
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->next;
+	else
+		elem->prev->next = elem->next;
+	if (elem->next != NULL)
+		elem->next->prev = elem->prev;
+	elem->next = elem->prev = NULL;
+}
@@ -0,0 +1,193 @@
+#include "lz.h"
+#include <string.h>
+#include "../debug.h"
+
+/* A compressed block is a sequence of sequences, each made of:
+
+     - A token byte.  Its high nibble is the number of literals,
+       and its low nibble the match length minus LZ_MIN_MATCH.
+       A nibble of 15 means that the value is 15 plus the sum of
+       the extension bytes that follow, up to and including the
+       first byte that is not 255.
+
+     - Literal length extension bytes, then the literals.
+
+     - The match offset, 2 bytes little-endian, counting back from
+       the current output position, and then the match length
+       extension bytes.
+
+   The last sequence ends after its literals: the end of input
+   takes the place of its match.  Matches may overlap the output
+   they copy to, so runs compress to a single match. */
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xffff
+
+/* Returns the 4 bytes at P, in the machine's byte order. */
+static inline uint32_t
+load32 (const uint8_t *p) {
+	uint32_t v;
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+/* Hashes the 4 bytes V to LZ_HASH_BITS bits. */
+static inline unsigned
+hash32 (uint32_t v) {
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes length extension bytes for LEN, which must be at least
+   15, to *OP, not going past END.  Returns false if they do not
+   fit. */
+static bool
+put_length (uint8_t **op, uint8_t *end, size_t len) {
+	for (len -= 15; ; len -= 255) {
+		if (*op >= end)
+			return false;
+		*(*op)++ = len < 255 ? len : 255;
+		if (len < 255)
+			return true;
+	}
+}
+
+/* Writes a sequence to *OP, not going past END: LIT_CNT literals
+   from LIT, and then, if MATCH_LEN is nonzero, a match of
+   MATCH_LEN bytes at OFFSET.  Returns false if it does not fit. */
+static bool
+put_sequence (uint8_t **op, uint8_t *end, const uint8_t *lit,
+		size_t lit_cnt, size_t offset, size_t match_len) {
+	size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+	uint8_t *token = *op;
+
+	if (*op >= end)
+		return false;
+	*token = (lit_cnt < 15 ? lit_cnt : 15) << 4
+		| (match_code < 15 ? match_code : 15);
+	(*op)++;
+
+	if (lit_cnt >= 15 && !put_length (op, end, lit_cnt))
+		return false;
+	if ((size_t) (end - *op) < lit_cnt)
+		return false;
+	memcpy (*op, lit, lit_cnt);
+	*op += lit_cnt;
+
+	if (match_len == 0)
+		return true;
+	if (end - *op < 2)
+		return false;
+	*(*op)++ = offset;
+	*(*op)++ = offset >> 8;
+	return match_code < 15 || put_length (op, end, match_code);
+}
+
+/* Compresses the SRC_SIZE bytes at SRC, which must be at most
+   LZ_MAX_BLOCK, into the DST_SIZE bytes at DST.  WORK must point
+   to LZ_WORK_SIZE bytes of scratch memory.  Returns the compressed
+   size, or 0 if it would exceed DST_SIZE. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+		void *dst_, size_t dst_size, void *work) {
+	const uint8_t *src = src_;
+	uint8_t *op = dst_;
+	uint8_t *end = op + dst_size;
+	uint16_t *table = work;
+	size_t anchor = 0;
+	size_t ip = 0;
+
+	ASSERT (src_size <= LZ_MAX_BLOCK);
+
+	while (ip + LZ_MIN_MATCH <= src_size) {
+		uint32_t v = load32 (src + ip);
+		unsigned h = hash32 (v);
+		size_t cand = table[h];
+
+		table[h] = ip;
+		/* TABLE may hold positions from an earlier block, but any
+		   earlier position whose bytes match is a valid match. */
+		if (cand < ip && ip - cand <= LZ_MAX_OFFSET
+				&& load32 (src + cand) == v) {
+			size_t len = LZ_MIN_MATCH;
+
+			while (ip + len < src_size && src[cand + len] == src[ip + len])
+				len++;
+			if (!put_sequence (&op, end, src + anchor, ip - anchor,
+						ip - cand, len))
+				return 0;
+			ip += len;
+			anchor = ip;
+		} else
+			ip++;
+	}
+
+	if (!put_sequence (&op, end, src + anchor, src_size - anchor, 0, 0))
+		return 0;
+	return op - (uint8_t *) dst_;
+}
+
+/* Reads a length extension from *IP, not going past END, adding it
+   to *LEN.  Returns false if the input ends first. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *len) {
+	uint8_t b;
+
+	do {
+		if (*ip >= end)
+			return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, produced by
+   lz_compress(), into the DST_SIZE bytes at DST.  Returns the
+   decompressed size, or 0 if SRC is malformed or decompresses to
+   more than DST_SIZE bytes. */
+size_t
+lz_decompress (const void *src_, size_t src_size,
+		void *dst_, size_t dst_size) {
+	const uint8_t *ip = src_;
+	const uint8_t *ip_end = ip + src_size;
+	uint8_t *dst = dst_;
+	uint8_t *op = dst;
+	uint8_t *op_end = dst + dst_size;
+
+	while (ip < ip_end) {
+		uint8_t token = *ip++;
+		size_t lit_cnt = token >> 4;
+		size_t match_len = token & 15;
+		size_t offset;
+
+		if (lit_cnt == 15 && !get_length (&ip, ip_end, &lit_cnt))
+			return 0;
+		if ((size_t) (ip_end - ip) < lit_cnt
+				|| (size_t) (op_end - op) < lit_cnt)
+			return 0;
+		memcpy (op, ip, lit_cnt);
+		ip += lit_cnt;
+		op += lit_cnt;
+
+		/* The last sequence has no match. */
+		if (ip == ip_end)
+			break;
+
+		if (ip_end - ip < 2)
+			return 0;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (match_len == 15 && !get_length (&ip, ip_end, &match_len))
+			return 0;
+		match_len += LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t) (op - dst)
+				|| (size_t) (op_end - op) < match_len)
+			return 0;
+
+		/* Byte by byte, since the source may overlap the
+		   destination. */
+		for (; match_len > 0; match_len--, op++)
+			*op = op[-offset];
+	}
+	return op - dst;
+}
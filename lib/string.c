@@ -1,5 +1,131 @@
 #include <string.h>
 #include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The memory primitives below move data 8 or 16 bytes at a time
+   through general-purpose registers, and use the x86 string
+   instructions for large blocks.  They never touch SSE
+   registers, since the kernel is built with -mno-sse and may
+   call them before any SSE state is set up.
+
+   On CPUs with "enhanced REP MOVSB/STOSB" (ERMS), `rep movsb' and
+   `rep stosb' are the fastest way to copy or fill a large block,
+   whatever its alignment.  Otherwise we align the destination
+   and use `rep movsq' and `rep stosq'. */
+
+/* Blocks of at least this many bytes use the string
+   instructions.  Below it, their startup cost dominates. */
+#define REP_MIN 128
+
+/* 8-byte word that may alias anything and be misaligned. */
+typedef uint64_t word_t __attribute__ ((may_alias, aligned (1)));
+
+/* Returns true if the CPU supports enhanced REP MOVSB/STOSB. */
+static bool
+has_erms (void) {
+	static int erms = -1;
+
+	if (erms < 0) {
+		uint32_t eax, ebx, ecx, edx;
+
+		asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+				: "a" (0), "c" (0));
+		erms = 0;
+		if (eax >= 7) {
+			asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+					: "a" (7), "c" (0));
+			erms = (ebx >> 9) & 1;
+		}
+	}
+	return erms;
+}
+
+/* Copies CNT bytes from SRC to DST with `rep movsb', in
+   ascending order. */
+static inline void
+rep_movsb (void *dst, const void *src, size_t cnt) {
+	asm volatile ("rep movsb"
+			: "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
+/* Copies CNT 8-byte words from SRC to DST with `rep movsq', in
+   ascending order. */
+static inline void
+rep_movsq (void *dst, const void *src, size_t cnt) {
+	asm volatile ("rep movsq"
+			: "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
+/* Stores CNT copies of byte VALUE at DST with `rep stosb'. */
+static inline void
+rep_stosb (void *dst, uint8_t value, size_t cnt) {
+	asm volatile ("rep stosb"
+			: "+D" (dst), "+c" (cnt) : "a" (value) : "memory");
+}
+
+/* Stores CNT copies of word VALUE at DST with `rep stosq'. */
+static inline void
+rep_stosq (void *dst, uint64_t value, size_t cnt) {
+	asm volatile ("rep stosq"
+			: "+D" (dst), "+c" (cnt) : "a" (value) : "memory");
+}
+
+/* Copies SIZE bytes from SRC to DST in ascending order, which
+   is safe even if they overlap as long as DST is below SRC. */
+static void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size) {
+	if (size >= REP_MIN) {
+		if (has_erms ()) {
+			rep_movsb (dst, src, size);
+			return;
+		}
+
+		/* Align DST, then copy words. */
+		size_t head = -(uintptr_t) dst & 7;
+		rep_movsb (dst, src, head);
+		dst += head;
+		src += head;
+		size -= head;
+		rep_movsq (dst, src, size / 8);
+		dst += size & ~(size_t) 7;
+		src += size & ~(size_t) 7;
+		size &= 7;
+	}
+
+	for (; size >= 16; size -= 16, dst += 16, src += 16) {
+		word_t a = ((const word_t *) src)[0];
+		word_t b = ((const word_t *) src)[1];
+		((word_t *) dst)[0] = a;
+		((word_t *) dst)[1] = b;
+	}
+	if (size >= 8) {
+		*(word_t *) dst = *(const word_t *) src;
+		dst += 8;
+		src += 8;
+		size -= 8;
+	}
+	while (size-- > 0)
+		*dst++ = *src++;
+}
+
+/* Copies SIZE bytes from SRC to DST in descending order, which
+   is safe even if they overlap as long as DST is above SRC. */
+static void
+copy_backward (unsigned char *dst, const unsigned char *src, size_t size) {
+	dst += size;
+	src += size;
+	for (; size >= 16; size -= 16) {
+		dst -= 16;
+		src -= 16;
+		word_t a = ((const word_t *) src)[0];
+		word_t b = ((const word_t *) src)[1];
+		((word_t *) dst)[1] = b;
+		((word_t *) dst)[0] = a;
+	}
+	while (size-- > 0)
+		*--dst = *--src;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -11,8 +137,7 @@ memcpy (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	while (size-- > 0)
-		*dst++ = *src++;
+	copy_forward (dst, src, size);
 
 	return dst_;
 }
@@ -27,17 +152,15 @@ memmove (void *dst_, const void *src_, size_t size) {
 	ASSERT (dst != NULL || size == 0);
 	ASSERT (src != NULL || size == 0);
 
-	if (dst < src) {
-		while (size-- > 0)
-			*dst++ = *src++;
-	} else {
-		dst += size;
-		src += size;
-		while (size-- > 0)
-			*--dst = *--src;
-	}
+	/* Forward copies read each 16-byte chunk before writing it,
+	   so they are safe when DST is below SRC.  So is `rep movsb',
+	   which is defined to move one byte at a time. */
+	if (dst <= src || dst >= src + size)
+		copy_forward (dst, src, size);
+	else
+		copy_backward (dst, src, size);
 
-	return dst;
+	return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -52,6 +175,10 @@ memcmp (const void *a_, const void *b_, size_t size) {
 	ASSERT (a != NULL || size == 0);
 	ASSERT (b != NULL || size == 0);
 
+	/* Skip over equal words, then find the differing byte. */
+	for (; size >= 8; size -= 8, a += 8, b += 8)
+		if (*(const word_t *) a != *(const word_t *) b)
+			break;
 	for (; size-- > 0; a++, b++)
 		if (*a != *b)
 			return *a > *b ? +1 : -1;
@@ -257,15 +384,62 @@ strtok_r (char *s, const char *delimiters, char **save_ptr) {
 void *
 memset (void *dst_, int value, size_t size) {
 	unsigned char *dst = dst_;
+	uint64_t word = (uint8_t) value * 0x0101010101010101ULL;
 
 	ASSERT (dst != NULL || size == 0);
 
+	if (size >= REP_MIN) {
+		if (has_erms ()) {
+			rep_stosb (dst, value, size);
+			return dst_;
+		}
+
+		/* Align DST, then fill words. */
+		size_t head = -(uintptr_t) dst & 7;
+		rep_stosb (dst, value, head);
+		dst += head;
+		size -= head;
+		rep_stosq (dst, word, size / 8);
+		dst += size & ~(size_t) 7;
+		size &= 7;
+	}
+
+	for (; size >= 16; size -= 16, dst += 16) {
+		((word_t *) dst)[0] = word;
+		((word_t *) dst)[1] = word;
+	}
+	if (size >= 8) {
+		*(word_t *) dst = word;
+		dst += 8;
+		size -= 8;
+	}
 	while (size-- > 0)
 		*dst++ = value;
 
 	return dst_;
 }
 
+/* Copies the 4 kB page at SRC to DST.  Both must be page-aligned
+   and must not overlap. */
+void *
+copy_page (void *dst, const void *src) {
+	ASSERT (((uintptr_t) dst & 0xfff) == 0);
+	ASSERT (((uintptr_t) src & 0xfff) == 0);
+
+	rep_movsq (dst, src, 4096 / 8);
+	return dst;
+}
+
+/* Sets the 4 kB page at DST, which must be page-aligned, to
+   zeros. */
+void *
+clear_page (void *dst) {
+	ASSERT (((uintptr_t) dst & 0xfff) == 0);
+
+	rep_stosq (dst, 0, 4096 / 8);
+	return dst;
+}
+
 /* Returns the length of STRING. */
 size_t
 strlen (const char *string) {
@@ -194,3 +194,8 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+bool
+sched_stats (int priority, struct sched_stats *stats) {
+	return syscall2 (SYS_SCHED_STATS, priority, stats);
+}
@@ -0,0 +1,95 @@
+/* Measures the time spent in the timer interrupt handler per
+   tick as the number of sleeping threads grows.
+
+   For each N, puts N threads to sleep on staggered, distant
+   wake-up ticks, then samples the cycles spent in interrupt
+   context over a fixed number of ticks.  If the sleepers are
+   scanned on every tick, the per-tick cost grows with N; with
+   the timer wheel it should stay flat.  Run it with -mlfqs to
+   include the advanced scheduler's per-tick bookkeeping.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of ticks to sample for. */
+#define SAMPLE_TICKS 100
+
+struct bench_alarm
+  {
+    int64_t wake_base;          /* Earliest wake-up tick. */
+    struct semaphore woke;      /* Upped by each sleeper. */
+  };
+
+struct sleeper_info
+  {
+    struct bench_alarm *bench;
+    int id;
+  };
+
+static void sleeper (void *);
+static void measure (int thread_cnt);
+
+void
+test_bench_alarm (void)
+{
+  measure (5);
+  measure (50);
+  measure (500);
+}
+
+/* Runs the benchmark with THREAD_CNT sleeping threads. */
+static void
+measure (int thread_cnt)
+{
+  static struct sleeper_info infos[500];
+  struct bench_alarm bench;
+  uint64_t cycles;
+  int64_t start;
+  int created, i;
+
+  ASSERT (thread_cnt <= (int) (sizeof infos / sizeof *infos));
+
+  sema_init (&bench.woke, 0);
+  bench.wake_base = timer_ticks () + SAMPLE_TICKS + 50;
+
+  for (created = 0; created < thread_cnt; created++)
+    {
+      char name[16];
+      infos[created].bench = &bench;
+      infos[created].id = created;
+      snprintf (name, sizeof name, "sleeper %d", created);
+      if (thread_create (name, PRI_DEFAULT, sleeper, &infos[created])
+          == TID_ERROR)
+        break;
+    }
+
+  /* Let the sleepers go to sleep, then start on a tick boundary. */
+  timer_sleep (10);
+
+  start = timer_ticks ();
+  cycles = timer_interrupt_cycles ();
+  timer_sleep (SAMPLE_TICKS);
+  cycles = timer_interrupt_cycles () - cycles;
+
+  for (i = 0; i < created; i++)
+    sema_down (&bench.woke);
+
+  msg ("%3d sleeping threads: %llu interrupt cycles per tick",
+       created, cycles / (uint64_t) (timer_ticks () - start));
+}
+
+/* Sleeps until a tick distinct to this thread, then reports. */
+static void
+sleeper (void *info_)
+{
+  struct sleeper_info *info = info_;
+
+  timer_sleep (info->bench->wake_base + info->id - timer_ticks ());
+  sema_up (&info->bench->woke);
+}
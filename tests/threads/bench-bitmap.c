@@ -0,0 +1,98 @@
+/* Measures bitmap_scan() on a bitmap of 1M bits at various fill
+   levels.
+
+   For each fill level, sets that share of the bits at random,
+   then times scans from the start of the bitmap for a single
+   clear bit and for a run of 8, and next-fit scans with
+   bitmap_scan_and_flip_next(), which is how swap slots are
+   allocated.  Scanning a bit at a time gets slower as the bitmap
+   fills up; scanning a word at a time should much less so.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <bitmap.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "intrinsic.h"
+
+/* Number of bits in the bitmap. */
+#define BIT_CNT (1024 * 1024)
+
+/* Number of scans to time for each measurement. */
+#define SCAN_CNT 100
+
+static void measure (struct bitmap *, int percent);
+static uint64_t time_scans (struct bitmap *, size_t cnt);
+static uint64_t time_next_fit (struct bitmap *);
+
+void
+test_bench_bitmap (void)
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+
+  ASSERT (b != NULL);
+  random_init (0);
+
+  measure (b, 10);
+  measure (b, 50);
+  measure (b, 90);
+  measure (b, 99);
+
+  bitmap_destroy (b);
+}
+
+/* Runs the benchmark with PERCENT% of B's bits set. */
+static void
+measure (struct bitmap *b, int percent)
+{
+  uint64_t first, run, next;
+  size_t i;
+
+  for (i = 0; i < BIT_CNT; i++)
+    bitmap_set (b, i, random_ulong () % 100 < (unsigned long) percent);
+
+  first = time_scans (b, 1);
+  run = time_scans (b, 8);
+  next = time_next_fit (b);
+
+  msg ("%2d%% full: %llu cycles per first-fit scan, %llu for a run of 8, "
+       "%llu per next-fit scan", percent, first, run, next);
+}
+
+/* Returns the average number of cycles taken to scan B from
+   the start for CNT clear bits. */
+static uint64_t
+time_scans (struct bitmap *b, size_t cnt)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < SCAN_CNT; i++)
+    bitmap_scan (b, 0, cnt, false);
+  return (rdtsc () - start) / SCAN_CNT;
+}
+
+/* Returns the average number of cycles taken to allocate a bit
+   from B by next-fit scanning.  Frees the bits again afterward. */
+static uint64_t
+time_next_fit (struct bitmap *b)
+{
+  static size_t taken[SCAN_CNT];
+  uint64_t start, cycles;
+  int i, cnt;
+
+  start = rdtsc ();
+  for (cnt = 0; cnt < SCAN_CNT; cnt++)
+    {
+      taken[cnt] = bitmap_scan_and_flip_next (b, 1, false);
+      if (taken[cnt] == BITMAP_ERROR)
+        break;
+    }
+  cycles = rdtsc () - start;
+
+  for (i = 0; i < cnt; i++)
+    bitmap_reset (b, taken[i]);
+  return cycles / (cnt > 0 ? cnt : 1);
+}
@@ -0,0 +1,97 @@
+/* Measures page allocation latency as the user pool fills up.
+
+   Allocates every page in the user pool, then frees pages spread
+   evenly over the pool until the given share of it is in use, so
+   that the free pages are scattered.  Then times SAMPLE_CNT
+   single-page allocations.  A first-fit scan gets slower as
+   occupancy grows; a buddy allocator should not.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "intrinsic.h"
+
+/* Number of allocations to time. */
+#define SAMPLE_CNT 100
+
+/* Pages are chained through their first word. */
+struct chained_page
+  {
+    struct chained_page *next;
+  };
+
+static void measure (int percent);
+
+void
+test_bench_palloc (void)
+{
+  measure (10);
+  measure (50);
+  measure (95);
+}
+
+/* Runs the benchmark with PERCENT% of the user pool in use. */
+static void
+measure (int percent)
+{
+  struct chained_page *all = NULL, *kept = NULL, *sampled = NULL, *p;
+  size_t total = 0, used = 0, i;
+  uint64_t cycles = 0;
+  int samples = 0;
+
+  /* Take every page. */
+  while ((p = palloc_get_page (PAL_USER)) != NULL)
+    {
+      p->next = all;
+      all = p;
+      total++;
+    }
+
+  /* Keep PERCENT% of them, spread over the pool. */
+  for (i = 0; all != NULL; i++)
+    {
+      p = all;
+      all = p->next;
+      if ((i * percent) % 100 < (size_t) percent
+          && used * 100 < total * percent)
+        {
+          p->next = kept;
+          kept = p;
+          used++;
+        }
+      else
+        palloc_free_page (p);
+    }
+
+  /* Time allocations from what is left. */
+  while (samples < SAMPLE_CNT)
+    {
+      uint64_t start = rdtsc ();
+      p = palloc_get_page (PAL_USER);
+      cycles += rdtsc () - start;
+      if (p == NULL)
+        break;
+      p->next = sampled;
+      sampled = p;
+      samples++;
+    }
+
+  while (sampled != NULL)
+    {
+      p = sampled;
+      sampled = p->next;
+      palloc_free_page (p);
+    }
+  while (kept != NULL)
+    {
+      p = kept;
+      kept = p->next;
+      palloc_free_page (p);
+    }
+
+  msg ("%2d%% of %zu pages in use: %llu cycles per allocation",
+       percent, total, cycles / (uint64_t) (samples > 0 ? samples : 1));
+}
@@ -0,0 +1,78 @@
+/* Measures the cost of a voluntary context switch.
+
+   Two threads hand control back and forth through a pair of
+   semaphores, so that every sema_up() wakes the other thread and
+   every sema_down() blocks and switches to it.  Reports the
+   average cost of a switch in cycles and, if the run took at
+   least one timer tick, the number of switches per second.  Run
+   it before and after a change to the context switch path to
+   compare the two.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+/* Number of round trips between the two threads. */
+#define ROUND_TRIPS 20000
+
+struct bench_pingpong
+  {
+    struct semaphore ping;      /* Upped by the main thread. */
+    struct semaphore pong;      /* Upped by the ponger. */
+  };
+
+static void ponger (void *);
+
+void
+test_bench_pingpong (void)
+{
+  struct bench_pingpong bench;
+  uint64_t cycles, switches;
+  int64_t start_ticks, ticks;
+  int i;
+
+  sema_init (&bench.ping, 0);
+  sema_init (&bench.pong, 0);
+  thread_create ("ponger", PRI_DEFAULT, ponger, &bench);
+
+  /* Warm up: make sure the ponger is waiting on PING. */
+  sema_up (&bench.ping);
+  sema_down (&bench.pong);
+
+  start_ticks = timer_ticks ();
+  cycles = rdtsc ();
+  for (i = 0; i < ROUND_TRIPS; i++)
+    {
+      sema_up (&bench.ping);
+      sema_down (&bench.pong);
+    }
+  cycles = rdtsc () - cycles;
+  ticks = timer_elapsed (start_ticks);
+
+  switches = 2 * (uint64_t) ROUND_TRIPS;
+  msg ("%llu switches: %llu cycles per switch", switches, cycles / switches);
+  if (ticks > 0)
+    msg ("%llu switches per second",
+         switches * TIMER_FREQ / (uint64_t) ticks);
+}
+
+/* Answers every PING with a PONG, ROUND_TRIPS times after the
+   warm-up round. */
+static void
+ponger (void *bench_)
+{
+  struct bench_pingpong *bench = bench_;
+  int i;
+
+  for (i = 0; i <= ROUND_TRIPS; i++)
+    {
+      sema_down (&bench->ping);
+      sema_up (&bench->pong);
+    }
+}
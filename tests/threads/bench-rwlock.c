@@ -0,0 +1,145 @@
+/* Measures read throughput of a read-mostly record under
+   contention, protected first by a lock and then by a
+   reader-writer lock.
+
+   READER_CNT threads repeatedly look up the record, spending a
+   little time inside the critical section each time, while one
+   writer updates it every few ticks.  With a lock, a reader
+   preempted inside its critical section holds up every other
+   reader; with a reader-writer lock, only the writer does.
+   Reports the number of reads completed per tick.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of reader threads. */
+#define READER_CNT 8
+
+/* Number of ticks to sample for. */
+#define SAMPLE_TICKS 100
+
+/* Ticks between writes. */
+#define WRITE_INTERVAL 5
+
+/* Iterations of busy work inside each read. */
+#define READ_LOOPS 2000
+
+struct bench_rwlock
+  {
+    bool use_rwlock;            /* Use RW instead of LOCK? */
+    struct lock lock;
+    struct rwlock rw;
+    volatile bool stop;         /* Set to end the run. */
+    struct semaphore exited;    /* Upped by each exiting thread. */
+    int64_t record;             /* The protected record. */
+    int64_t reads;              /* Reads completed, under SUM_LOCK. */
+    struct lock sum_lock;
+  };
+
+static void reader (void *);
+static void writer (void *);
+static void measure (bool use_rwlock);
+
+void
+test_bench_rwlock (void)
+{
+  measure (false);
+  measure (true);
+}
+
+/* Runs the benchmark with a lock or, if USE_RWLOCK, with a
+   reader-writer lock. */
+static void
+measure (bool use_rwlock)
+{
+  struct bench_rwlock bench;
+  int64_t start;
+  int i;
+
+  bench.use_rwlock = use_rwlock;
+  lock_init (&bench.lock);
+  rwlock_init (&bench.rw);
+  bench.stop = false;
+  sema_init (&bench.exited, 0);
+  bench.record = 0;
+  bench.reads = 0;
+  lock_init (&bench.sum_lock);
+
+  for (i = 0; i < READER_CNT; i++)
+    thread_create ("reader", PRI_DEFAULT, reader, &bench);
+  thread_create ("writer", PRI_DEFAULT, writer, &bench);
+
+  start = timer_ticks ();
+  timer_sleep (SAMPLE_TICKS);
+  bench.stop = true;
+  for (i = 0; i < READER_CNT + 1; i++)
+    sema_down (&bench.exited);
+
+  msg ("%s: %lld reads per tick", use_rwlock ? "rwlock" : "lock",
+       bench.reads / timer_elapsed (start));
+}
+
+/* Reads the record until the benchmark is over. */
+static void
+reader (void *bench_)
+{
+  struct bench_rwlock *bench = bench_;
+  int64_t reads = 0;
+
+  while (!bench->stop)
+    {
+      volatile int64_t value UNUSED;
+      int i;
+
+      if (bench->use_rwlock)
+        rwlock_acquire_read (&bench->rw);
+      else
+        lock_acquire (&bench->lock);
+
+      for (i = 0; i < READ_LOOPS; i++)
+        value = bench->record;
+
+      if (bench->use_rwlock)
+        rwlock_release_read (&bench->rw);
+      else
+        lock_release (&bench->lock);
+      reads++;
+    }
+
+  lock_acquire (&bench->sum_lock);
+  bench->reads += reads;
+  lock_release (&bench->sum_lock);
+  sema_up (&bench->exited);
+}
+
+/* Updates the record every WRITE_INTERVAL ticks until the
+   benchmark is over. */
+static void
+writer (void *bench_)
+{
+  struct bench_rwlock *bench = bench_;
+
+  while (!bench->stop)
+    {
+      timer_sleep (WRITE_INTERVAL);
+
+      if (bench->use_rwlock)
+        rwlock_acquire_write (&bench->rw);
+      else
+        lock_acquire (&bench->lock);
+
+      bench->record++;
+
+      if (bench->use_rwlock)
+        rwlock_release_write (&bench->rw);
+      else
+        lock_release (&bench->lock);
+    }
+  sema_up (&bench->exited);
+}
@@ -0,0 +1,89 @@
+/* Measures the cost of a context switch as the number of
+   runnable threads grows.
+
+   The main thread creates N threads at its own priority, each of
+   which yields in a loop, and then yields repeatedly itself.
+   Every yield puts a thread at the back of the busiest priority
+   level and takes the next one from its front, so a run queue
+   whose operations depend on the number of ready threads shows
+   up as a per-switch cost that grows with N.  With a constant
+   time run queue the reported cost should stay flat from 10 to
+   1000 threads.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Number of yields by the main thread per measurement. */
+#define YIELD_CNT 20
+
+struct bench_sched
+  {
+    volatile bool stop;         /* Set to make the yielders exit. */
+    struct semaphore exited;    /* Upped by each exiting yielder. */
+  };
+
+static void yielder (void *);
+static void measure (int thread_cnt);
+
+void
+test_bench_sched (void)
+{
+  /* This benchmark does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  measure (10);
+  measure (100);
+  measure (1000);
+}
+
+/* Runs the benchmark with THREAD_CNT runnable threads. */
+static void
+measure (int thread_cnt)
+{
+  struct bench_sched bench;
+  uint64_t start, cycles;
+  int created, i;
+
+  bench.stop = false;
+  sema_init (&bench.exited, 0);
+
+  for (created = 0; created < thread_cnt; created++)
+    {
+      char name[24];
+      snprintf (name, sizeof name, "yielder %d", created);
+      if (thread_create (name, PRI_DEFAULT, yielder, &bench) == TID_ERROR)
+        break;
+    }
+
+  /* Let every yielder reach its loop once before timing. */
+  thread_yield ();
+
+  start = rdtsc ();
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield ();
+  cycles = rdtsc () - start;
+
+  bench.stop = true;
+  for (i = 0; i < created; i++)
+    sema_down (&bench.exited);
+
+  msg ("%4d runnable threads: %llu cycles per context switch",
+       created, cycles / ((uint64_t) YIELD_CNT * (created + 1)));
+}
+
+/* Yields until the benchmark is over. */
+static void
+yielder (void *bench_)
+{
+  struct bench_sched *bench = bench_;
+
+  while (!bench->stop)
+    thread_yield ();
+  sema_up (&bench->exited);
+}
@@ -0,0 +1,88 @@
+/* Measures the cost of waking a thread from a contended
+   semaphore as the number of waiters grows.
+
+   N threads of mixed priorities, all below the main thread's,
+   block on one semaphore.  The main thread then ups it N times
+   and times each sema_up().  The waiters cannot preempt it, so
+   only the wait queue operations and the unblock are measured.
+   If sema_up() sorts the waiters, the cost grows with N; with a
+   priority heap it grows only logarithmically.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+/* Number of distinct waiter priorities. */
+#define PRI_CNT 20
+
+struct bench_sema
+  {
+    struct semaphore sema;      /* The contended semaphore. */
+    struct semaphore done;      /* Upped by each waiter on exit. */
+  };
+
+static void waiter (void *);
+static void measure (int thread_cnt);
+
+void
+test_bench_sema (void)
+{
+  /* This benchmark does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  measure (10);
+  measure (200);
+}
+
+/* Runs the benchmark with THREAD_CNT waiters. */
+static void
+measure (int thread_cnt)
+{
+  struct bench_sema bench;
+  uint64_t cycles = 0;
+  int created, i;
+
+  sema_init (&bench.sema, 0);
+  sema_init (&bench.done, 0);
+
+  for (created = 0; created < thread_cnt; created++)
+    {
+      char name[24];
+      snprintf (name, sizeof name, "waiter %d", created);
+      if (thread_create (name, PRI_DEFAULT - 1 - created % PRI_CNT,
+                         waiter, &bench) == TID_ERROR)
+        break;
+    }
+
+  /* Let every waiter block on the semaphore. */
+  timer_sleep (10);
+
+  for (i = 0; i < created; i++)
+    {
+      uint64_t start = rdtsc ();
+      sema_up (&bench.sema);
+      cycles += rdtsc () - start;
+    }
+
+  for (i = 0; i < created; i++)
+    sema_down (&bench.done);
+
+  msg ("%3d waiters: %llu cycles per sema_up", created,
+       cycles / (uint64_t) (created > 0 ? created : 1));
+}
+
+/* Waits on the semaphore once. */
+static void
+waiter (void *bench_)
+{
+  struct bench_sema *bench = bench_;
+
+  sema_down (&bench->sema);
+  sema_up (&bench->done);
+}
@@ -0,0 +1,85 @@
+/* Measures the memory primitives in lib/string.c for blocks of
+   16 bytes to 4 kB, and the page-sized copy_page() and
+   clear_page().
+
+   Copies and fills go between two page-aligned buffers, and
+   memmove() shifts a block by 8 bytes within one buffer, so
+   that it takes the overlapping path.  memcmp() compares two
+   equal blocks, which is its slowest case.
+
+   This is a benchmark, not a pass/fail test. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Number of calls to time for each measurement. */
+#define CALL_CNT 1000
+
+static void measure (uint8_t *dst, uint8_t *src, size_t size);
+
+void
+test_bench_string (void)
+{
+  uint8_t *dst = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, 2);
+  uint8_t *src = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, 2);
+  uint64_t start, page_copy, page_clear;
+  size_t size;
+  int i;
+
+  for (size = 16; size <= PGSIZE; size *= 4)
+    measure (dst, src, size);
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    copy_page (dst, src);
+  page_copy = (rdtsc () - start) / CALL_CNT;
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    clear_page (dst);
+  page_clear = (rdtsc () - start) / CALL_CNT;
+
+  msg ("copy_page: %llu cycles, clear_page: %llu cycles",
+       page_copy, page_clear);
+
+  palloc_free_multiple (dst, 2);
+  palloc_free_multiple (src, 2);
+}
+
+/* Times each primitive on SIZE-byte blocks at DST and SRC. */
+static void
+measure (uint8_t *dst, uint8_t *src, size_t size)
+{
+  uint64_t start, copy, move, set, cmp;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    memcpy (dst, src, size);
+  copy = (rdtsc () - start) / CALL_CNT;
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    memmove (dst + 8, dst, size);
+  move = (rdtsc () - start) / CALL_CNT;
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    memset (dst, i, size);
+  set = (rdtsc () - start) / CALL_CNT;
+
+  memcpy (dst, src, size);
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    if (memcmp (dst, src, size) != 0)
+      fail ("memcmp() found a difference in equal blocks");
+  cmp = (rdtsc () - start) / CALL_CNT;
+
+  msg ("%4zu bytes: memcpy %llu, memmove %llu, memset %llu, "
+       "memcmp %llu cycles", size, copy, move, set, cmp);
+}
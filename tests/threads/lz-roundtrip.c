@@ -0,0 +1,99 @@
+/* Compresses and decompresses representative pages with
+   lz_compress() and lz_decompress(), checking that each comes
+   back unchanged, and that a page that does not compress to
+   vm/zswap.c's limit of three quarters of a page is refused. */
+
+#include <stdio.h>
+#include <string.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include <lz.h>
+
+/* Compressed size limit, as MAX_COMPRESSED in vm/zswap.c. */
+#define COMPRESSED_MAX (PGSIZE * 3 / 4)
+
+static uint8_t *src, *dst, *out;
+static uint8_t work[LZ_WORK_SIZE];
+
+static void round_trip (const char *name, size_t dst_size, bool fits);
+
+void
+test_lz_roundtrip (void) 
+{
+  size_t i;
+
+  src = palloc_get_page (PAL_ASSERT);
+  dst = palloc_get_multiple (PAL_ASSERT, 2);
+  out = palloc_get_page (PAL_ASSERT);
+
+  /* A zero page compresses to one long overlapping match. */
+  memset (src, 0, PGSIZE);
+  round_trip ("zero page", COMPRESSED_MAX, true);
+
+  /* A short repeated pattern copies from an offset smaller than
+     the match length. */
+  for (i = 0; i < PGSIZE; i++)
+    src[i] = "abc"[i % 3];
+  round_trip ("3-byte pattern", COMPRESSED_MAX, true);
+
+  /* Runs of varying length, with literals between them, need
+     the length extension bytes for literals and matches. */
+  random_init (1);
+  for (i = 0; i < PGSIZE; ) 
+    {
+      size_t run = random_ulong () % 300 + 1;
+      size_t lit = random_ulong () % 40;
+      uint8_t byte = random_ulong ();
+
+      for (; run > 0 && i < PGSIZE; run--)
+        src[i++] = byte;
+      for (; lit > 0 && i < PGSIZE; lit--)
+        src[i++] = random_ulong ();
+    }
+  round_trip ("runs and literals", COMPRESSED_MAX, true);
+
+  /* Random bytes do not compress.  They still round-trip given
+     room for the literals and their tokens. */
+  random_bytes (src, PGSIZE);
+  round_trip ("random page", COMPRESSED_MAX, false);
+  round_trip ("random page", 2 * PGSIZE, true);
+
+  /* A compressed block must not decompress past its buffer. */
+  memset (src, 0, PGSIZE);
+  i = lz_compress (src, PGSIZE, dst, COMPRESSED_MAX, work);
+  if (lz_decompress (dst, i, out, PGSIZE - 1) != 0)
+    fail ("zero page decompressed into too small a buffer");
+  msg ("short output buffer: refused");
+
+  palloc_free_page (src);
+  palloc_free_multiple (dst, 2);
+  palloc_free_page (out);
+}
+
+/* Compresses the page at SRC into at most DST_SIZE bytes and
+   checks that it fits if and only if FITS is true.  If it fits,
+   decompresses it and checks that the result equals SRC. */
+static void
+round_trip (const char *name, size_t dst_size, bool fits) 
+{
+  size_t size = lz_compress (src, PGSIZE, dst, dst_size, work);
+
+  if (!fits) 
+    {
+      if (size != 0)
+        fail ("%s: compressed to %zu bytes, limit %zu", name, size, dst_size);
+      msg ("%s: does not fit in %zu bytes", name, dst_size);
+      return;
+    }
+
+  if (size == 0)
+    fail ("%s: does not fit in %zu bytes", name, dst_size);
+  memset (out, 0xcc, PGSIZE);
+  if (lz_decompress (dst, size, out, PGSIZE) != PGSIZE)
+    fail ("%s: decompressed to the wrong size", name);
+  if (memcmp (src, out, PGSIZE))
+    fail ("%s: decompressed data differs", name);
+  msg ("%s: round trip ok", name);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lz-roundtrip) begin
+(lz-roundtrip) zero page: round trip ok
+(lz-roundtrip) 3-byte pattern: round trip ok
+(lz-roundtrip) runs and literals: round trip ok
+(lz-roundtrip) random page: does not fit in 3072 bytes
+(lz-roundtrip) random page: round trip ok
+(lz-roundtrip) short output buffer: refused
+(lz-roundtrip) end
+EOF
+pass;
@@ -0,0 +1,84 @@
+/* Tests that cond_signal() wakes up the highest-priority waiter
+   when a waiter's priority changes after it was preempted between
+   joining the condition's waiters and blocking.
+
+   Thread "x" waits on the condition while thread "h" waits for
+   the lock, so releasing the lock in cond_wait() preempts "x"
+   before it blocks.  "h" then donates its priority to "x", which
+   must move it ahead of thread "mid". */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func waiter_thread;
+static thread_func x_thread;
+static thread_func h_thread;
+static struct lock lock;
+static struct lock donation_lock;
+static struct condition condition;
+
+void
+test_priority_condvar_preempt (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init (&lock);
+  lock_init (&donation_lock);
+  cond_init (&condition);
+
+  thread_set_priority (PRI_MIN);
+  thread_create ("low", PRI_DEFAULT - 10, waiter_thread, NULL);
+  thread_create ("mid", PRI_DEFAULT - 6, waiter_thread, NULL);
+  thread_create ("x", PRI_DEFAULT - 8, x_thread, NULL);
+
+  for (i = 0; i < 3; i++) 
+    {
+      lock_acquire (&lock);
+      msg ("Signaling...");
+      cond_signal (&condition, &lock);
+      lock_release (&lock);
+    }
+}
+
+static void
+waiter_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s starting.", thread_name ());
+  lock_acquire (&lock);
+  cond_wait (&condition, &lock);
+  msg ("Thread %s woke up.", thread_name ());
+  lock_release (&lock);
+}
+
+static void
+x_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s starting.", thread_name ());
+  lock_acquire (&donation_lock);
+  lock_acquire (&lock);
+  thread_create ("h", PRI_DEFAULT, h_thread, NULL);
+  cond_wait (&condition, &lock);
+  msg ("Thread %s woke up.", thread_name ());
+  lock_release (&lock);
+  lock_release (&donation_lock);
+}
+
+static void
+h_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s starting.", thread_name ());
+  lock_acquire (&lock);
+  msg ("Thread %s got the lock; x is ready but waiting.", thread_name ());
+  lock_release (&lock);
+  lock_acquire (&donation_lock);
+  msg ("Thread %s got the donation lock.", thread_name ());
+  lock_release (&donation_lock);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-condvar-preempt) begin
+(priority-condvar-preempt) Thread low starting.
+(priority-condvar-preempt) Thread mid starting.
+(priority-condvar-preempt) Thread x starting.
+(priority-condvar-preempt) Thread h starting.
+(priority-condvar-preempt) Thread h got the lock; x is ready but waiting.
+(priority-condvar-preempt) Signaling...
+(priority-condvar-preempt) Thread x woke up.
+(priority-condvar-preempt) Thread h got the donation lock.
+(priority-condvar-preempt) Signaling...
+(priority-condvar-preempt) Thread mid woke up.
+(priority-condvar-preempt) Signaling...
+(priority-condvar-preempt) Thread low woke up.
+(priority-condvar-preempt) end
+EOF
+pass;
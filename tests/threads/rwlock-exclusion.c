@@ -0,0 +1,52 @@
+/* Tests that two readers hold a reader-writer lock at the same
+   time and that a writer waits until both have released it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread;
+static thread_func writer_thread;
+static struct rwlock rw;
+static struct semaphore go;
+
+void
+test_rwlock_exclusion (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rw);
+  sema_init (&go, 0);
+
+  thread_create ("reader 1", PRI_DEFAULT + 1, reader_thread, NULL);
+  thread_create ("reader 2", PRI_DEFAULT + 1, reader_thread, NULL);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+  msg ("Main thread: the writer waits for %u readers.", rw.readers);
+
+  sema_up (&go);
+  msg ("Main thread: the writer waits for %u reader.", rw.readers);
+  sema_up (&go);
+  msg ("Main thread: the writer is done.");
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rw);
+  msg ("Thread %s acquired the rwlock for reading.", thread_name ());
+  sema_down (&go);
+  msg ("Thread %s releasing the rwlock.", thread_name ());
+  rwlock_release_read (&rw);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_write (&rw);
+  msg ("Thread %s acquired the rwlock for writing with %u readers.",
+       thread_name (), rw.readers);
+  rwlock_release_write (&rw);
+}
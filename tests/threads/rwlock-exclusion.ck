@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-exclusion) begin
+(rwlock-exclusion) Thread reader 1 acquired the rwlock for reading.
+(rwlock-exclusion) Thread reader 2 acquired the rwlock for reading.
+(rwlock-exclusion) Main thread: the writer waits for 2 readers.
+(rwlock-exclusion) Thread reader 1 releasing the rwlock.
+(rwlock-exclusion) Main thread: the writer waits for 1 reader.
+(rwlock-exclusion) Thread reader 2 releasing the rwlock.
+(rwlock-exclusion) Thread writer acquired the rwlock for writing with 0 readers.
+(rwlock-exclusion) Main thread: the writer is done.
+(rwlock-exclusion) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Tests that a reader that arrives while a writer waits for a
+   reader-writer lock gets it only after the writer is done, even
+   though the rwlock is held for reading when it arrives. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func first_reader_thread;
+static thread_func late_reader_thread;
+static thread_func writer_thread;
+static struct rwlock rw;
+static struct semaphore go;
+
+void
+test_rwlock_writer_pref (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rw);
+  sema_init (&go, 0);
+
+  thread_create ("reader 1", PRI_DEFAULT + 1, first_reader_thread, NULL);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+  thread_create ("reader 2", PRI_DEFAULT + 1, late_reader_thread, NULL);
+  msg ("Main thread: reader 2 waits behind the writer.");
+
+  sema_up (&go);
+  msg ("Main thread: all threads are done.");
+}
+
+static void
+first_reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rw);
+  msg ("Thread %s acquired the rwlock for reading.", thread_name ());
+  sema_down (&go);
+  msg ("Thread %s releasing the rwlock.", thread_name ());
+  rwlock_release_read (&rw);
+}
+
+static void
+late_reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rw);
+  msg ("Thread %s acquired the rwlock for reading.", thread_name ());
+  rwlock_release_read (&rw);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_write (&rw);
+  msg ("Thread %s acquired the rwlock for writing.", thread_name ());
+  msg ("Thread %s releasing the rwlock.", thread_name ());
+  rwlock_release_write (&rw);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-pref) begin
+(rwlock-writer-pref) Thread reader 1 acquired the rwlock for reading.
+(rwlock-writer-pref) Main thread: reader 2 waits behind the writer.
+(rwlock-writer-pref) Thread reader 1 releasing the rwlock.
+(rwlock-writer-pref) Thread writer acquired the rwlock for writing.
+(rwlock-writer-pref) Thread writer releasing the rwlock.
+(rwlock-writer-pref) Thread reader 2 acquired the rwlock for reading.
+(rwlock-writer-pref) Main thread: all threads are done.
+(rwlock-writer-pref) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Tests that a read of a record protected by a sequence lock is
+   retried if a write overlaps it, and only then. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread;
+static struct seqlock seq;
+static int first, second;
+
+static void read_record (bool write);
+
+void
+test_seqlock_retry (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  seqlock_init (&seq);
+  read_record (false);
+  read_record (true);
+  read_record (false);
+}
+
+/* Reads the record, letting a higher-priority writer update it
+   between the reads of its two fields if WRITE is true, and
+   retries for as long as a write overlaps the read. */
+static void
+read_record (bool write) 
+{
+  int tries = 0;
+  unsigned start;
+  int a, b;
+
+  do 
+    {
+      tries++;
+      start = seqlock_read_begin (&seq);
+      a = first;
+      if (write && tries == 1)
+        thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+      b = second;
+    }
+  while (seqlock_read_retry (&seq, start));
+
+  msg ("Read (%d, %d) after %d %s.", a, b, tries, tries == 1 ? "try" : "tries");
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  seqlock_write_begin (&seq);
+  first++;
+  second++;
+  seqlock_write_end (&seq);
+  msg ("Thread %s wrote (%d, %d).", thread_name (), first, second);
+}
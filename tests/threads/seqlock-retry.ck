@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(seqlock-retry) begin
+(seqlock-retry) Read (0, 0) after 1 try.
+(seqlock-retry) Thread writer wrote (1, 1).
+(seqlock-retry) Read (1, 1) after 2 tries.
+(seqlock-retry) Read (1, 1) after 1 try.
+(seqlock-retry) end
+EOF
+pass;
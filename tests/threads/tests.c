@@ -29,6 +29,11 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-condvar-preempt", test_priority_condvar_preempt},
+    {"rwlock-exclusion", test_rwlock_exclusion},
+    {"rwlock-writer-pref", test_rwlock_writer_pref},
+    {"seqlock-retry", test_seqlock_retry},
+    {"lz-roundtrip", test_lz_roundtrip},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +43,14 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"bench-sched", test_bench_sched},
+    {"bench-alarm", test_bench_alarm},
+    {"bench-pingpong", test_bench_pingpong},
+    {"bench-rwlock", test_bench_rwlock},
+    {"bench-sema", test_bench_sema},
+    {"bench-palloc", test_bench_palloc},
+    {"bench-bitmap", test_bench_bitmap},
+    {"bench-string", test_bench_string},
   };
 
 static const char *test_name;
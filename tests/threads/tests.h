@@ -23,6 +23,11 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_condvar_preempt;
+extern test_func test_rwlock_exclusion;
+extern test_func test_rwlock_writer_pref;
+extern test_func test_seqlock_retry;
+extern test_func test_lz_roundtrip;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +37,14 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_bench_sched;
+extern test_func test_bench_alarm;
+extern test_func test_bench_pingpong;
+extern test_func test_bench_rwlock;
+extern test_func test_bench_sema;
+extern test_func test_bench_palloc;
+extern test_func test_bench_bitmap;
+extern test_func test_bench_string;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,43 @@
+/* Reads the scheduler statistics with the sched_stats system
+   call and checks that they are consistent: each histogram's
+   buckets add up to its sample count, and the switches out at
+   the caller's priority add up to its time slice samples. */
+
+#include <schedstat.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void check_hist (const char *name, const struct sched_hist *);
+
+void
+test_main (void) 
+{
+  struct sched_stats s;
+
+  CHECK (sched_stats (-1, &s), "sched_stats (-1)");
+  check_hist ("wakeup", &s.prio.wakeup);
+  check_hist ("runnable", &s.prio.runnable);
+  check_hist ("slice", &s.prio.slice);
+  CHECK (s.prio.runnable.cnt > 0, "runnable samples for our priority");
+  CHECK (s.prio.voluntary + s.prio.involuntary == s.prio.slice.cnt,
+         "switches add up to time slices");
+  CHECK (s.thread.wakeup_max <= s.thread.wakeup_sum,
+         "longest wakeup within total");
+
+  CHECK (!sched_stats (-2, &s), "sched_stats (-2) must fail");
+  CHECK (!sched_stats (64, &s), "sched_stats (64) must fail");
+}
+
+/* Checks that histogram H, labeled NAME, is consistent. */
+static void
+check_hist (const char *name, const struct sched_hist *h) 
+{
+  uint64_t total = 0;
+  int b;
+
+  for (b = 0; b < SCHEDSTAT_BUCKETS; b++)
+    total += h->buckets[b];
+  CHECK (total == h->cnt, "%s buckets add up to sample count", name);
+  CHECK (h->max <= h->sum, "%s maximum within sum", name);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-stats) begin
+(sched-stats) sched_stats (-1)
+(sched-stats) wakeup buckets add up to sample count
+(sched-stats) wakeup maximum within sum
+(sched-stats) runnable buckets add up to sample count
+(sched-stats) runnable maximum within sum
+(sched-stats) slice buckets add up to sample count
+(sched-stats) slice maximum within sum
+(sched-stats) runnable samples for our priority
+(sched-stats) switches add up to time slices
+(sched-stats) longest wakeup within total
+(sched-stats) sched_stats (-2) must fail
+(sched-stats) sched_stats (64) must fail
+(sched-stats) end
+sched-stats: exit(0)
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Checks that the kernel's writes to a page shared copy-on-write,
+   here read() into a buffer, give the writer a copy of its own
+   instead of changing the page under the other process. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+
+static char buf[sizeof sample] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+	pid_t child;
+	void *pa_parent;
+	void *pa_child;
+	int handle;
+
+	memset (buf, 'x', sizeof buf);
+	pa_parent = get_phys_addr (buf);
+
+	child = fork ("child");
+	if (child == 0) {
+		pa_child = get_phys_addr (buf);
+		CHECK (pa_parent == pa_child, "two phys addrs should be the same.");
+
+		CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+		CHECK (read (handle, buf, sizeof sample - 1) == (int) sizeof sample - 1,
+				"read \"sample.txt\"");
+		CHECK (memcmp (buf, sample, sizeof sample - 1) == 0, "check data change");
+
+		pa_child = get_phys_addr (buf);
+		CHECK (pa_parent != pa_child, "two phys addrs should not be the same.");
+		close (handle);
+		return;
+	}
+	wait (child);
+	CHECK (pa_parent == get_phys_addr (buf), "two phys addrs should be the same.");
+	CHECK (buf[0] == 'x' && buf[sizeof sample - 2] == 'x',
+			"check data consistency");
+	return;
+}
@@ -0,0 +1,86 @@
+/* Reads a large BSS array, which must read as zeros without each
+   page getting a frame of its own, then writes to it and checks
+   that the writes land.  Also has read() write into BSS pages
+   that the process has not touched, and into one that it has
+   only read, so that the kernel's write must fault on a
+   read-only mapping. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (4 * 1024 * 1024)
+
+static char big[SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char untouched[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char read_only[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char spare[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+/* Returns the byte that the write pass stores at offset OFS of
+   BIG. */
+static char
+expected (size_t ofs)
+{
+  size_t page = ofs / PAGE_SIZE;
+
+  return ofs % PAGE_SIZE == page % PAGE_SIZE ? page % 255 + 1 : 0;
+}
+
+/* Fails unless the SIZE bytes at BUF are all zero. */
+static void
+check_zero (const char *name, const char *buf, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu of %s is %02hhx, not 0", i, name, buf[i]);
+}
+
+/* Reads sample.txt into BUF and checks the data. */
+static void
+read_sample (const char *name, char *buf)
+{
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, buf, sizeof sample - 1) == (int) sizeof sample - 1,
+         "read \"sample.txt\" into %s", name);
+  CHECK (memcmp (buf, sample, sizeof sample - 1) == 0,
+         "check data in %s", name);
+  close (handle);
+}
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read pass");
+  check_zero ("big", big, SIZE);
+  CHECK (get_phys_addr (big) == get_phys_addr (big + SIZE - PAGE_SIZE),
+         "pages that were only read share a frame");
+
+  msg ("write pass");
+  for (i = 0; i < SIZE / PAGE_SIZE; i++)
+    big[i * PAGE_SIZE + i % PAGE_SIZE] = expected (i * PAGE_SIZE + i % PAGE_SIZE);
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (big[i] != expected (i))
+      fail ("byte %zu of big is %02hhx, not %02hhx", i, big[i], expected (i));
+  CHECK (get_phys_addr (big) != get_phys_addr (big + SIZE - PAGE_SIZE),
+         "written pages have frames of their own");
+
+  read_sample ("untouched page", untouched);
+
+  check_zero ("spare", spare, PAGE_SIZE);
+  check_zero ("read-only page", read_only, PAGE_SIZE);
+  read_sample ("read-only page", read_only);
+  check_zero ("read-only page tail", read_only + sizeof sample - 1,
+              PAGE_SIZE - (sizeof sample - 1));
+  check_zero ("spare", spare, PAGE_SIZE);
+}
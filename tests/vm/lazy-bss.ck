@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(lazy-bss) begin
+(lazy-bss) read pass
+(lazy-bss) pages that were only read share a frame
+(lazy-bss) write pass
+(lazy-bss) read pass
+(lazy-bss) written pages have frames of their own
+(lazy-bss) open "sample.txt"
+(lazy-bss) read "sample.txt" into untouched page
+(lazy-bss) check data in untouched page
+(lazy-bss) open "sample.txt"
+(lazy-bss) read "sample.txt" into read-only page
+(lazy-bss) check data in read-only page
+(lazy-bss) end
+lazy-bss: exit(0)
+EOF
+pass;
@@ -5,40 +5,95 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
    The size of each request, in bytes, is rounded up to a power
    of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
-
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
-
-   When we free a block, we add it to its descriptor's free list.
-   But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   that size.
+
+   Each descriptor has a "magazine" of free blocks.  If the
+   magazine is nonempty, one of its blocks is used to satisfy the
+   request, without taking any lock: disabling interrupts is
+   enough to keep other threads off the magazines, since the
+   kernel runs on a single CPU.  Freed blocks likewise go back
+   into the magazine.  Only when a magazine runs empty, or grows to twice
+   the descriptor's batch size, does it take the descriptor's
+   lock to move a batch of blocks from or to the arenas.
+
+   An "arena" is a page of memory obtained from the page
+   allocator (if none is available, malloc() returns a null
+   pointer) and divided into blocks.  The descriptor keeps a list
+   of the arenas that have free blocks, and each arena keeps its
+   own list of freed blocks.  A new arena's blocks are not put on
+   any list: they are carved off the end of the arena in order
+   as they are needed.
+
+   When an arena has no in-use blocks left, we give it back to
+   the page allocator.  Blocks held in magazines count as in use
+   for this purpose.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   descriptor.  Requests of up to MID_MAX bytes go to "mid-size
+   classes" instead, spaced four to each power of 2, so that
+   rounding up wastes at most 20% of a block.  Each class carves
+   its blocks out of "spans" of contiguous pages, sized so that
+   the blocks fill them exactly, and with the span's header
+   allocated separately.  Since a block may cross page
+   boundaries, the span is found through the page allocator's
+   per-page owner pointer.  A span is given back to the page
+   allocator as soon as it has no in-use blocks.
+
+   Bigger requests still get contiguous pages from the page
+   allocator, with the allocation size stuck at the beginning of
+   the allocated block's arena header. */
+
+/* Maximum number of descriptors. */
+#define DESC_MAX 10
+
+/* Maximum number of blocks moved between a magazine and the
+   arenas at a time. */
+#define MAG_BATCH_MAX 16
+
+/* Largest request served by a mid-size class. */
+#define MID_MAX (64 * 1024)
+
+/* Maximum number of mid-size classes. */
+#define MID_CLASS_MAX 32
+
+/* Mid-size class. */
+struct mid_class {
+	size_t block_size;          /* Size of each element in bytes. */
+	size_t blocks_per_span;     /* Number of blocks in a span. */
+	size_t span_pages;          /* Number of pages in a span. */
+	struct list spans;          /* Spans with free blocks. */
+	struct lock lock;           /* Lock. */
+	size_t span_cnt;            /* Number of spans. */
+	size_t used_cnt;            /* Number of blocks in use. */
+};
+
+/* Span of pages divided into blocks of a mid-size class. */
+struct span {
+	struct mid_class *class;    /* Owning class. */
+	uint8_t *base;              /* First page. */
+	size_t free_cnt;            /* Free blocks. */
+	size_t carved_cnt;          /* Blocks carved off so far. */
+	struct block *free_list;    /* Freed blocks. */
+	struct list_elem elem;      /* Element in class's spans list. */
+};
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
-	struct list free_list;      /* List of free blocks. */
+	size_t mag_batch;           /* Blocks per magazine refill or drain. */
+	struct list arenas;         /* Arenas with free blocks. */
 	struct lock lock;           /* Lock. */
 };
 
@@ -50,17 +105,39 @@ struct arena {
 	unsigned magic;             /* Always set to ARENA_MAGIC. */
 	struct desc *desc;          /* Owning descriptor, null for big block. */
 	size_t free_cnt;            /* Free blocks; pages in big block. */
+	size_t carved_cnt;          /* Blocks carved off so far. */
+	struct block *free_list;    /* Freed blocks. */
+	struct list_elem elem;      /* Element in desc's arenas list. */
 };
 
 /* Free block. */
 struct block {
-	struct list_elem free_elem; /* Free list element. */
+	struct block *next;         /* Next block in free list or magazine. */
 };
 
-/* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
-static size_t desc_cnt;         /* Number of descriptors. */
+/* Free blocks of one descriptor cached outside its arenas. */
+struct magazine {
+	struct block *top;          /* Most recently freed block. */
+	size_t cnt;                 /* Number of blocks. */
+};
 
+/* Our set of descriptors. */
+static struct desc descs[DESC_MAX];     /* Descriptors. */
+static size_t desc_cnt;                 /* Number of descriptors. */
+
+/* Magazines, indexed by descriptor. */
+static struct magazine magazines[DESC_MAX];
+
+/* Our set of mid-size classes. */
+static struct mid_class mid_classes[MID_CLASS_MAX];
+static size_t mid_class_cnt;
+
+static struct block *desc_get_blocks (struct desc *, size_t cnt);
+static void mid_class_init (struct mid_class *, size_t block_size);
+static void *mid_alloc (size_t size);
+static void mid_free (struct span *, struct block *);
+static void desc_put_blocks (struct desc *, struct block *);
+static bool big_extend (void *, size_t new_size);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -74,9 +151,53 @@ malloc_init (void) {
 		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
 		d->block_size = block_size;
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
+
+		/* Let a magazine hold at most about half an arena, so
+		   that the blocks cached for each descriptor stay
+		   within a page. */
+		d->mag_batch = d->blocks_per_arena / 4;
+		if (d->mag_batch < 1)
+			d->mag_batch = 1;
+		if (d->mag_batch > MAG_BATCH_MAX)
+			d->mag_batch = MAG_BATCH_MAX;
+
+		list_init (&d->arenas);
 		lock_init (&d->lock);
 	}
+
+	/* Mid-size classes from just above the largest descriptor
+	   up to MID_MAX, four to each power of 2. */
+	for (block_size = descs[desc_cnt - 1].block_size;
+			block_size < MID_MAX; block_size *= 2) {
+		size_t i;
+
+		for (i = 5; i <= 8; i++) {
+			struct mid_class *c = &mid_classes[mid_class_cnt++];
+			ASSERT (mid_class_cnt <= sizeof mid_classes / sizeof *mid_classes);
+			mid_class_init (c, block_size * i / 4);
+		}
+	}
+}
+
+/* Initializes mid-size class C for blocks of BLOCK_SIZE bytes. */
+static void
+mid_class_init (struct mid_class *c, size_t block_size) {
+	size_t blocks = 1;
+
+	/* Use the fewest blocks that fill whole pages exactly, then
+	   double that while the span stays small, so that small
+	   classes don't need a new span for every few blocks. */
+	while (blocks * block_size % PGSIZE != 0)
+		blocks++;
+	while (blocks < 4 && blocks * block_size * 2 <= MID_MAX)
+		blocks *= 2;
+
+	c->block_size = block_size;
+	c->blocks_per_span = blocks;
+	c->span_pages = blocks * block_size / PGSIZE;
+	list_init (&c->spans);
+	lock_init (&c->lock);
+	c->span_cnt = c->used_cnt = 0;
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -84,8 +205,10 @@ malloc_init (void) {
 void *
 malloc (size_t size) {
 	struct desc *d;
+	struct magazine *m;
 	struct block *b;
 	struct arena *a;
+	enum intr_level old_level;
 
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
@@ -97,8 +220,13 @@ malloc (size_t size) {
 		if (d->block_size >= size)
 			break;
 	if (d == descs + desc_cnt) {
-		/* SIZE is too big for any descriptor.
-		   Allocate enough pages to hold SIZE plus an arena. */
+		/* SIZE is too big for any descriptor.  Use a mid-size
+		   class if it fits one. */
+		if (size <= MID_MAX)
+			return mid_alloc (size);
+
+		/* Otherwise, allocate enough pages to hold SIZE plus an
+		   arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
 		a = palloc_get_multiple (0, page_cnt);
 		if (a == NULL)
@@ -112,34 +240,34 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
-
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
-
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
-		}
-
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
+	/* Take a block from the magazine, if it has one. */
+	old_level = intr_disable ();
+	m = &magazines[d - descs];
+	b = m->top;
+	if (b != NULL) {
+		m->top = b->next;
+		m->cnt--;
+	}
+	intr_set_level (old_level);
+	if (b != NULL)
+		return b;
+
+	/* Refill the magazine from the arenas.  We keep the first
+	   block for ourselves. */
+	b = desc_get_blocks (d, d->mag_batch);
+	if (b != NULL && b->next != NULL) {
+		struct block *last;
+		size_t cnt = 1;
+
+		for (last = b->next; last->next != NULL; last = last->next)
+			cnt++;
+
+		old_level = intr_disable ();
+		last->next = m->top;
+		m->top = b->next;
+		m->cnt += cnt;
+		intr_set_level (old_level);
 	}
-
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
 	return b;
 }
 
@@ -167,9 +295,15 @@ calloc (size_t a, size_t b) {
 static size_t
 block_size (void *block) {
 	struct block *b = block;
-	struct arena *a = block_to_arena (b);
-	struct desc *d = a->desc;
+	struct span *s = palloc_get_owner (b);
+	struct arena *a;
+	struct desc *d;
+
+	if (s != NULL)
+		return s->class->block_size;
 
+	a = block_to_arena (b);
+	d = a->desc;
 	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
@@ -178,12 +312,23 @@ block_size (void *block) {
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
-   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+   If OLD_BLOCK already has room for NEW_SIZE bytes, and would
+   not be more than half empty, it is resized in place.  A big
+   block is also grown in place if the pages just past it are
+   free.  A mid-size block never is: every block in a span has
+   its class's size, and the memory past it is the next block of
+   the same class, so it has to move to a bigger class. */
 void *
 realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
+	} else if (old_block != NULL && new_size <= block_size (old_block)
+			&& new_size > block_size (old_block) / 2) {
+		return old_block;
+	} else if (old_block != NULL && big_extend (old_block, new_size)) {
+		return old_block;
 	} else {
 		void *new_block = malloc (new_size);
 		if (old_block != NULL && new_block != NULL) {
@@ -196,41 +341,78 @@ realloc (void *old_block, size_t new_size) {
 	}
 }
 
+/* Grows BLOCK, if it is a big block, to hold NEW_SIZE bytes
+   without moving it, by taking the free pages just past it.
+   Returns true if successful, false if BLOCK is unchanged. */
+static bool
+big_extend (void *block, size_t new_size) {
+	struct arena *a;
+	size_t page_cnt;
+
+	if (new_size <= MID_MAX || palloc_get_owner (block) != NULL)
+		return false;
+
+	a = block_to_arena (block);
+	if (a->desc != NULL)
+		return false;
+
+	page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+	if (page_cnt <= a->free_cnt || !palloc_extend (a, a->free_cnt, page_cnt))
+		return false;
+	a->free_cnt = page_cnt;
+	return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) {
 	if (p != NULL) {
 		struct block *b = p;
-		struct arena *a = block_to_arena (b);
-		struct desc *d = a->desc;
+		struct span *s = palloc_get_owner (b);
+		struct arena *a;
+		struct desc *d;
+
+		if (s != NULL) {
+			/* It's a mid-size block. */
+			mid_free (s, b);
+			return;
+		}
 
+		a = block_to_arena (b);
+		d = a->desc;
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
+			struct magazine *m;
+			struct block *drain = NULL;
+			enum intr_level old_level;
 
 #ifndef NDEBUG
 			/* Clear the block to help detect use-after-free bugs. */
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
+			/* Put the block in the magazine.  If that
+			   fills the magazine, take a batch of its oldest
+			   blocks back out to return to the arenas. */
+			old_level = intr_disable ();
+			m = &magazines[d - descs];
+			b->next = m->top;
+			m->top = b;
+			if (++m->cnt >= 2 * d->mag_batch) {
+				struct block *last = m->top;
 				size_t i;
 
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+				for (i = 1; i < d->mag_batch; i++)
+					last = last->next;
+				drain = last->next;
+				last->next = NULL;
+				m->cnt = d->mag_batch;
 			}
+			intr_set_level (old_level);
 
-			lock_release (&d->lock);
+			if (drain != NULL)
+				desc_put_blocks (d, drain);
 		} else {
 			/* It's a big block.  Free its pages. */
 			palloc_free_multiple (a, a->free_cnt);
@@ -238,7 +420,198 @@ free (void *p) {
 		}
 	}
 }
-
+
+/* Takes up to CNT free blocks of descriptor D from its arenas,
+   creating a new arena if needed, and returns them as a chain.
+   Returns a null pointer if memory is not available. */
+static struct block *
+desc_get_blocks (struct desc *d, size_t cnt) {
+	struct block *chain = NULL;
+
+	lock_acquire (&d->lock);
+	while (cnt > 0) {
+		struct arena *a;
+		struct block *b;
+
+		/* If no arena has a free block, create a new one.  Its
+		   blocks are carved off as needed, below. */
+		if (list_empty (&d->arenas)) {
+			a = palloc_get_page (0);
+			if (a == NULL)
+				break;
+			a->magic = ARENA_MAGIC;
+			a->desc = d;
+			a->free_cnt = d->blocks_per_arena;
+			a->carved_cnt = 0;
+			a->free_list = NULL;
+			list_push_front (&d->arenas, &a->elem);
+		}
+
+		/* Get a block from the first arena, preferring blocks
+		   that have been used before. */
+		a = list_entry (list_front (&d->arenas), struct arena, elem);
+		if (a->free_list != NULL) {
+			b = a->free_list;
+			a->free_list = b->next;
+		} else
+			b = arena_to_block (a, a->carved_cnt++);
+		if (--a->free_cnt == 0)
+			list_remove (&a->elem);
+
+		b->next = chain;
+		chain = b;
+		cnt--;
+	}
+	lock_release (&d->lock);
+
+	return chain;
+}
+
+/* Returns the chain of blocks starting at B to their arenas,
+   all of which belong to descriptor D. */
+static void
+desc_put_blocks (struct desc *d, struct block *b) {
+	lock_acquire (&d->lock);
+	while (b != NULL) {
+		struct block *next = b->next;
+		struct arena *a = block_to_arena (b);
+
+		ASSERT (a->desc == d);
+
+		/* Add block to its arena's free list. */
+		b->next = a->free_list;
+		a->free_list = b;
+		if (a->free_cnt++ == 0)
+			list_push_front (&d->arenas, &a->elem);
+
+		/* If the arena is now entirely unused, free it. */
+		if (a->free_cnt >= d->blocks_per_arena) {
+			ASSERT (a->free_cnt == d->blocks_per_arena);
+			list_remove (&a->elem);
+			palloc_free_page (a);
+		}
+
+		b = next;
+	}
+	lock_release (&d->lock);
+}
+
+/* Obtains and returns a block from the smallest mid-size class
+   that holds SIZE bytes.  Returns a null pointer if memory is not
+   available. */
+static void *
+mid_alloc (size_t size) {
+	struct mid_class *c;
+	struct span *s;
+	struct block *b;
+
+	for (c = mid_classes; c->block_size < size; c++)
+		ASSERT (c + 1 < mid_classes + mid_class_cnt);
+
+	lock_acquire (&c->lock);
+
+	/* If no span has a free block, create a new one.  Its blocks
+	   are carved off as needed, below. */
+	if (list_empty (&c->spans)) {
+		s = malloc (sizeof *s);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		s->base = palloc_get_multiple (0, c->span_pages);
+		if (s->base == NULL) {
+			lock_release (&c->lock);
+			free (s);
+			return NULL;
+		}
+		s->class = c;
+		s->free_cnt = c->blocks_per_span;
+		s->carved_cnt = 0;
+		s->free_list = NULL;
+		palloc_set_owner (s->base, c->span_pages, s);
+		list_push_front (&c->spans, &s->elem);
+		c->span_cnt++;
+	}
+
+	/* Get a block from the first span, preferring blocks that
+	   have been used before. */
+	s = list_entry (list_front (&c->spans), struct span, elem);
+	if (s->free_list != NULL) {
+		b = s->free_list;
+		s->free_list = b->next;
+	} else
+		b = (struct block *) (s->base + s->carved_cnt++ * c->block_size);
+	if (--s->free_cnt == 0)
+		list_remove (&s->elem);
+	c->used_cnt++;
+
+	lock_release (&c->lock);
+	return b;
+}
+
+/* Frees mid-size block B, which is inside span S. */
+static void
+mid_free (struct span *s, struct block *b) {
+	struct mid_class *c = s->class;
+	bool release = false;
+
+	/* Check that the block is properly aligned for the span. */
+	ASSERT ((uint8_t *) b >= s->base);
+	ASSERT (((uint8_t *) b - s->base) % c->block_size == 0);
+
+#ifndef NDEBUG
+	/* Clear the block to help detect use-after-free bugs. */
+	memset (b, 0xcc, c->block_size);
+#endif
+
+	lock_acquire (&c->lock);
+
+	/* Add block to its span's free list. */
+	b->next = s->free_list;
+	s->free_list = b;
+	if (s->free_cnt++ == 0)
+		list_push_front (&c->spans, &s->elem);
+	c->used_cnt--;
+
+	/* If the span is now entirely unused, free it. */
+	if (s->free_cnt == c->blocks_per_span) {
+		list_remove (&s->elem);
+		c->span_cnt--;
+		release = true;
+	}
+
+	lock_release (&c->lock);
+
+	if (release) {
+		palloc_free_multiple (s->base, c->span_pages);
+		free (s);
+	}
+}
+
+/* Prints how much of the memory held by mid-size classes is in
+   use. */
+void
+malloc_print_stats (void) {
+	size_t used = 0, held = 0;
+	size_t i;
+
+	for (i = 0; i < mid_class_cnt; i++) {
+		struct mid_class *c = &mid_classes[i];
+
+		if (c->span_cnt == 0)
+			continue;
+		printf ("Malloc: %zu-byte class: %zu of %zu blocks in use, "
+				"%zu pages\n", c->block_size, c->used_cnt,
+				c->span_cnt * c->blocks_per_span,
+				c->span_cnt * c->span_pages);
+		used += c->used_cnt * c->block_size;
+		held += c->span_cnt * c->span_pages * PGSIZE;
+	}
+	printf ("Malloc: %zu of %zu kB held by mid-size classes in use, "
+			"%zu%% fragmentation\n", used / 1024, held / 1024,
+			held > 0 ? (held - used) * 100 / held : 0);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
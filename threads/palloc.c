@@ -2,12 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -24,13 +26,73 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free memory is kept as
+   blocks of 2**K pages, aligned to their size relative to the
+   pool's base, on one free list per order K.  An allocation
+   splits the smallest large enough free block in halves until it
+   has the size it needs, and a free merges a block with its
+   "buddy", the other half of the block it was split from,
+   for as long as the buddy is free too.  Both take O(log n) time
+   in the size of the pool.  A request for a page count that is
+   not a power of two takes the next larger block and frees its
+   tail right away.
+
+   Free blocks are linked through a struct free_block at their
+   start.  The only other metadata is a byte per page saying
+   whether it heads a free block, and of which order, so that a
+   buddy can be checked in constant time.  In debug builds a
+   bitmap of used pages is kept as well, to cross-check frees.
+
+   Each allocated page also has an "owner" pointer that the
+   allocating code may set with palloc_set_owner(), so that it
+   can find its own metadata for any page of a multi-page
+   allocation.  Freeing a page clears its owner.
+
+   Each pool also keeps a list of free pages that have already
+   been zeroed, so that a PAL_ZERO request for a single page does
+   not have to clear it on the allocating thread.  The idle
+   thread fills the list by calling palloc_zero_idle() when it
+   would otherwise halt the CPU: whenever the list falls below
+   ZERO_LOW pages, it is refilled up to ZERO_HIGH.  Pages on the
+   list count as allocated as far as the buddy allocator is
+   concerned.  A request that the free lists cannot satisfy falls
+   back on them, so they do not make any memory unavailable. */
+
+/* Largest block order: blocks of up to 2**MAX_ORDER pages. */
+#define MAX_ORDER 20
+
+/* In a pool's page_info, set if the page heads a free block.  The
+   low bits hold the block's order. */
+#define PAGE_FREE 0x80
+
+/* Pre-zeroed page watermarks, in pages per pool. */
+#define ZERO_LOW 8                  /* Start refilling below this. */
+#define ZERO_HIGH 32                /* Stop refilling at this. */
+
+/* Header at the start of a free block. */
+struct free_block {
+	struct list_elem elem;          /* Element in a free list. */
+};
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct bitmap *used_map;        /* Bitmap of used pages (debugging). */
 	uint8_t *base;                  /* Base of pool. */
+	size_t page_cnt;                /* Number of pages in pool. */
+	uint8_t *page_info;             /* Order | PAGE_FREE, per page. */
+	void **owners;                  /* Owner, per page. */
+	struct list free_lists[MAX_ORDER + 1]; /* Free blocks, per order. */
+	uint32_t free_mask;             /* Bit K set iff free_lists[K] nonempty. */
+	size_t free_cnt;                /* Number of free pages. */
+
+	/* Pre-zeroed pages.  Accessed with interrupts off. */
+	struct list zeroed;             /* Zeroed pages, as free_blocks. */
+	size_t zeroed_cnt;              /* Number of pages on zeroed. */
+	size_t zero_low, zero_high;     /* Watermarks. */
+	bool zero_refill;               /* Refilling up to zero_high? */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,10 +100,22 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* PAL_ZERO requests served from and not from the zeroed lists. */
+static uint64_t zero_hits, zero_misses;
+
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_alloc (struct pool *, size_t page_cnt);
+static void pool_release (struct pool *, size_t page_idx, size_t page_cnt);
+static void block_push (struct pool *, size_t page_idx, int order);
+static void block_remove (struct pool *, size_t page_idx, int order);
+static size_t block_find (struct pool *, size_t page_idx, int *order);
+static int order_for (size_t page_cnt);
+static void *zeroed_pop (struct pool *);
+static void zeroed_drain (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -219,16 +293,16 @@ split:
 			else
 				NOT_REACHED ();
 
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
+			pool_end = pool->base + pool->page_cnt * PGSIZE;
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_release (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_release (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,20 +336,44 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = NULL;
+	size_t page_idx;
+
+	if (page_cnt == 0)
+		return NULL;
+
+	/* A page that is already zeroed needs no clearing. */
+	if (page_cnt == 1 && (flags & PAL_ZERO)) {
+		pages = zeroed_pop (pool);
+		if (pages != NULL) {
+			zero_hits++;
+			return pages;
+		}
+	}
 
 	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	page_idx = pool_alloc (pool, page_cnt);
+	if (page_idx == BITMAP_ERROR && page_cnt > 1) {
+		/* Give the zeroed pages back, in case they complete a
+		   large enough block, and try again. */
+		zeroed_drain (pool);
+		page_idx = pool_alloc (pool, page_cnt);
+	}
 	lock_release (&pool->lock);
-	void *pages;
 
 	if (page_idx != BITMAP_ERROR)
 		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	else if (page_cnt == 1)
+		pages = zeroed_pop (pool);
 
 	if (pages) {
-		if (flags & PAL_ZERO)
-			memset (pages, 0, PGSIZE * page_cnt);
+		if (flags & PAL_ZERO) {
+			size_t i;
+
+			for (i = 0; i < page_cnt; i++)
+				clear_page ((uint8_t *) pages + PGSIZE * i);
+			zero_misses++;
+		}
 	} else {
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
@@ -314,12 +412,17 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 		NOT_REACHED ();
 
 	page_idx = pg_no (pages) - pg_no (pool->base);
+	memset (pool->owners + page_idx, 0, sizeof *pool->owners * page_cnt);
 
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	lock_acquire (&pool->lock);
+#ifndef NDEBUG
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+#endif
+	pool_release (pool, page_idx, page_cnt);
+	lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +431,372 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Grows the allocation of PAGE_CNT pages starting at PAGES to
+   NEW_CNT pages, by taking the pages just past it, if they are
+   all free.  Returns true if successful, false if the
+   allocation is left as it was. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt) {
+	struct pool *pool;
+	size_t start, end, idx;
+	size_t lo_idx = 0, lo_cnt = 0, hi_idx = 0, hi_cnt = 0;
+	int order;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (page_cnt <= new_cnt);
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+
+	start = pg_no (pages) - pg_no (pool->base) + page_cnt;
+	end = start + (new_cnt - page_cnt);
+	if (end > pool->page_cnt)
+		return false;
+
+	lock_acquire (&pool->lock);
+
+	/* Check that free blocks cover the whole range... */
+	for (idx = start; idx < end; idx += (size_t) 1 << order) {
+		idx = block_find (pool, idx, &order);
+		if (idx == BITMAP_ERROR) {
+			lock_release (&pool->lock);
+			return false;
+		}
+	}
+
+	/* ...take them off the free lists... */
+	for (idx = start; idx < end; ) {
+		size_t head = block_find (pool, idx, &order);
+		size_t block_end = head + ((size_t) 1 << order);
+
+		block_remove (pool, head, order);
+		pool->free_cnt -= (size_t) 1 << order;
+		if (head < start) {
+			lo_idx = head;
+			lo_cnt = start - head;
+		}
+		if (block_end > end) {
+			hi_idx = end;
+			hi_cnt = block_end - end;
+		}
+		idx = block_end;
+	}
+
+	/* ...and give back the parts of the first and last blocks
+	   that lie outside it. */
+	if (lo_cnt > 0)
+		pool_release (pool, lo_idx, lo_cnt);
+	if (hi_cnt > 0)
+		pool_release (pool, hi_idx, hi_cnt);
+
+#ifndef NDEBUG
+	ASSERT (!bitmap_any (pool->used_map, start, end - start));
+	bitmap_set_multiple (pool->used_map, start, end - start, true);
+#endif
+	lock_release (&pool->lock);
+	return true;
+}
+
+/* Zeroes a free page for a pool whose list of zeroed pages is
+   being refilled, and adds it to the list.  Called by the idle
+   thread, with interrupts on, when it has nothing else to do.
+   Returns true if it zeroed a page, false if there was nothing
+   to do or the pools were busy. */
+bool
+palloc_zero_idle (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	size_t i;
+
+	for (i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *pool = pools[i];
+		struct free_block *b;
+		enum intr_level old_level;
+		size_t page_idx;
+
+		/* The idle thread must not sleep, so skip a pool whose
+		   lock is held.  While we hold it, keep interrupts off,
+		   so that no thread can wait for it and try to donate
+		   its priority to the idle thread.  Leave some pages on
+		   the free lists, so that we don't take the last free
+		   pages just to zero them. */
+		if (!pool->zero_refill)
+			continue;
+		page_idx = BITMAP_ERROR;
+		old_level = intr_disable ();
+		if (lock_try_acquire (&pool->lock)) {
+			if (pool->free_cnt > pool->zero_high)
+				page_idx = pool_alloc (pool, 1);
+			lock_release (&pool->lock);
+		}
+		intr_set_level (old_level);
+		if (page_idx == BITMAP_ERROR)
+			continue;
+
+		b = (void *) (pool->base + PGSIZE * page_idx);
+		clear_page (b);
+
+		old_level = intr_disable ();
+		list_push_front (&pool->zeroed, &b->elem);
+		if (++pool->zeroed_cnt >= pool->zero_high)
+			pool->zero_refill = false;
+		intr_set_level (old_level);
+		return true;
+	}
+	return false;
+}
+
+/* Prints statistics about pre-zeroed pages. */
+void
+palloc_print_stats (void) {
+	printf ("Palloc: %"PRIu64" zeroed page hits, %"PRIu64" misses\n",
+			zero_hits, zero_misses);
+}
+
+/* Sets the owner of the PAGE_CNT allocated pages starting at
+   PAGES to OWNER. */
+void
+palloc_set_owner (void *pages, size_t page_cnt, void *owner) {
+	struct pool *pool;
+	size_t page_idx, i;
+
+	ASSERT (pg_ofs (pages) == 0);
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+
+	page_idx = pg_no (pages) - pg_no (pool->base);
+	ASSERT (page_idx + page_cnt <= pool->page_cnt);
+	for (i = 0; i < page_cnt; i++)
+		pool->owners[page_idx + i] = owner;
+}
+
+/* Returns the owner of the allocated page that contains ADDR,
+   as set by palloc_set_owner(), or a null pointer if it has
+   none. */
+void *
+palloc_get_owner (const void *addr) {
+	struct pool *pool;
+
+	if (page_from_pool (&kernel_pool, (void *) addr))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, (void *) addr))
+		pool = &user_pool;
+	else
+		return NULL;
+
+	return pool->owners[pg_no (addr) - pg_no (pool->base)];
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
+  /* We'll put the pool's used_map, page_info and owners at
+     *BM_BASE.  Calculate the space needed for them and advance
+     *BM_BASE past it. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t info_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	size_t owner_pages =
+		DIV_ROUND_UP (pgcnt * sizeof (void *), PGSIZE) * PGSIZE;
 
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
+	p->page_info = *bm_base + bm_pages;
+	p->owners = *bm_base + bm_pages + info_pages;
+	for (int order = 0; order <= MAX_ORDER; order++)
+		list_init (&p->free_lists[order]);
+	p->free_mask = 0;
+	p->free_cnt = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	memset (p->page_info, 0, pgcnt);
+	memset (p->owners, 0, pgcnt * sizeof (void *));
+
+	list_init (&p->zeroed);
+	p->zeroed_cnt = 0;
+	p->zero_high = pgcnt / 16 < ZERO_HIGH ? pgcnt / 16 : ZERO_HIGH;
+	p->zero_low = p->zero_high < ZERO_LOW ? p->zero_high : ZERO_LOW;
+	p->zero_refill = p->zero_high > 0;
+
+	*bm_base += bm_pages + info_pages + owner_pages;
+}
+
+/* Allocates a block of PAGE_CNT pages from POOL, whose lock must
+   be held, and returns the index of its first page, or
+   BITMAP_ERROR if no free block is large enough. */
+static size_t
+pool_alloc (struct pool *pool, size_t page_cnt) {
+	int order = order_for (page_cnt);
+	int k;
+	size_t page_idx;
+
+	if (order > MAX_ORDER || (pool->free_mask >> order) == 0)
+		return BITMAP_ERROR;
+
+	/* Take the smallest free block that is large enough... */
+	k = order + __builtin_ctz (pool->free_mask >> order);
+	page_idx = pg_no (list_entry (list_front (&pool->free_lists[k]),
+				struct free_block, elem)) - pg_no (pool->base);
+	block_remove (pool, page_idx, k);
+	pool->free_cnt -= (size_t) 1 << k;
+
+	/* ...split off its upper halves until it has ORDER... */
+	while (k > order) {
+		k--;
+		block_push (pool, page_idx + ((size_t) 1 << k), k);
+		pool->free_cnt += (size_t) 1 << k;
+	}
+
+	/* ...and give back the pages past PAGE_CNT. */
+	if (page_cnt < (size_t) 1 << order)
+		pool_release (pool, page_idx + page_cnt,
+				((size_t) 1 << order) - page_cnt);
+
+#ifndef NDEBUG
+	ASSERT (!bitmap_any (pool->used_map, page_idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+#endif
+	return page_idx;
+}
+
+/* Frees the PAGE_CNT pages starting at index PAGE_IDX in POOL,
+   whose lock must be held, merging them with free buddies. */
+static void
+pool_release (struct pool *pool, size_t page_idx, size_t page_cnt) {
+#ifndef NDEBUG
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+#endif
+	pool->free_cnt += page_cnt;
+
+	/* Free the range as the largest aligned blocks that fit. */
+	while (page_cnt > 0) {
+		int order = 0;
+		size_t idx = page_idx;
+
+		while (order < MAX_ORDER && (page_idx & ((size_t) 1 << order)) == 0
+				&& (size_t) 2 << order <= page_cnt)
+			order++;
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+
+		/* Merge with the buddy for as long as it is free. */
+		while (order < MAX_ORDER) {
+			size_t buddy = idx ^ ((size_t) 1 << order);
+
+			if (buddy + ((size_t) 1 << order) > pool->page_cnt
+					|| pool->page_info[buddy] != (PAGE_FREE | order))
+				break;
+			block_remove (pool, buddy, order);
+			idx &= ~((size_t) 1 << order);
+			order++;
+		}
+		block_push (pool, idx, order);
+	}
+}
+
+/* Adds the block of order ORDER at PAGE_IDX to POOL's free
+   lists. */
+static void
+block_push (struct pool *pool, size_t page_idx, int order) {
+	struct free_block *b = (void *) (pool->base + PGSIZE * page_idx);
+
+	list_push_front (&pool->free_lists[order], &b->elem);
+	pool->free_mask |= 1u << order;
+	pool->page_info[page_idx] = PAGE_FREE | order;
+}
+
+/* Removes the free block of order ORDER at PAGE_IDX from POOL's
+   free lists. */
+static void
+block_remove (struct pool *pool, size_t page_idx, int order) {
+	struct free_block *b = (void *) (pool->base + PGSIZE * page_idx);
+
+	ASSERT (pool->page_info[page_idx] == (PAGE_FREE | order));
+	list_remove (&b->elem);
+	if (list_empty (&pool->free_lists[order]))
+		pool->free_mask &= ~(1u << order);
+	pool->page_info[page_idx] = 0;
+}
+
+/* Returns the index of the first page of the free block in POOL
+   that contains the page at PAGE_IDX, and stores its order in
+   *ORDER, or returns BITMAP_ERROR if that page is not free.
+   POOL's lock must be held. */
+static size_t
+block_find (struct pool *pool, size_t page_idx, int *order) {
+	int k;
+
+	for (k = 0; k <= MAX_ORDER; k++) {
+		size_t head = page_idx & ~(((size_t) 1 << k) - 1);
+
+		if (pool->page_info[head] == (PAGE_FREE | k)) {
+			*order = k;
+			return head;
+		}
+	}
+	return BITMAP_ERROR;
+}
+
+/* Takes a page off POOL's list of zeroed pages and returns it,
+   fully zeroed, or returns a null pointer if the list is
+   empty. */
+static void *
+zeroed_pop (struct pool *pool) {
+	struct free_block *b = NULL;
+	enum intr_level old_level = intr_disable ();
+
+	if (!list_empty (&pool->zeroed)) {
+		b = list_entry (list_pop_front (&pool->zeroed),
+				struct free_block, elem);
+		if (--pool->zeroed_cnt < pool->zero_low)
+			pool->zero_refill = true;
+	}
+	intr_set_level (old_level);
+
+	if (b != NULL)
+		memset (b, 0, sizeof *b);
+	return b;
+}
+
+/* Returns all of POOL's zeroed pages to its free lists.  POOL's
+   lock must be held. */
+static void
+zeroed_drain (struct pool *pool) {
+	struct list pages;
+	enum intr_level old_level = intr_disable ();
+
+	list_init (&pages);
+	while (!list_empty (&pool->zeroed))
+		list_push_back (&pages, list_pop_front (&pool->zeroed));
+	pool->zeroed_cnt = 0;
+	pool->zero_refill = pool->zero_high > 0;
+	intr_set_level (old_level);
+
+	while (!list_empty (&pages)) {
+		struct free_block *page = list_entry (list_pop_front (&pages),
+				struct free_block, elem);
+		pool_release (pool, pg_no (page) - pg_no (pool->base), 1);
+	}
+}
+
+/* Returns the order of the smallest block of at least PAGE_CNT
+   pages. */
+static int
+order_for (size_t page_cnt) {
+	int order = 0;
 
-	*bm_base += bm_pages;
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -353,6 +805,6 @@ static bool
 page_from_pool (const struct pool *pool, void *page) {
 	size_t page_no = pg_no (page);
 	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
+	size_t end_page = start_page + pool->page_cnt;
 	return page_no >= start_page && page_no < end_page;
 }
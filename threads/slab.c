@@ -0,0 +1,292 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab caches for fixed-size kernel objects.
+
+   malloc() rounds every request up to a power of 2, which wastes
+   up to half of each block for objects such as struct page or
+   struct inode that are allocated often and in large numbers.
+   A slab cache instead serves objects of one exact size.
+
+   Each "slab" is one page obtained from the page allocator.  It
+   starts with a header, followed by as many objects as fit in
+   the rest of the page.  The header holds a bitmap with a set
+   bit for each free object, so finding a free object is a scan
+   for the first nonzero word.  The cache keeps a list of the
+   slabs that have free objects.
+
+   If the cache has a constructor, it is run on every object when
+   its slab is created, not on every allocation.  Objects are
+   expected to be back in their constructed state when they are
+   freed, so that expensive initialization, such as of locks and
+   lists, is done once per object instead of once per use.
+
+   When a slab has no objects in use, it is given back to the
+   page allocator, unless it is the cache's only slab with free
+   objects.  Keeping that one slab prevents a caller that
+   allocates and frees a single object in a loop from creating
+   and destroying a slab each time. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Maximum number of objects per slab. */
+#define SLAB_OBJS_MAX 512
+
+/* Number of words in a slab's free bitmap. */
+#define SLAB_MAP_WORDS (SLAB_OBJS_MAX / 64)
+
+/* Objects are aligned to this many bytes. */
+#define SLAB_ALIGN 8
+
+/* Slab cache. */
+struct slab_cache {
+	const char *name;           /* Name, for statistics. */
+	size_t obj_size;            /* Object size, rounded up to SLAB_ALIGN. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	slab_ctor_func *ctor;       /* Constructor, or a null pointer. */
+	struct list partial;        /* Slabs with free objects. */
+	struct lock lock;           /* Lock. */
+
+	/* Statistics. */
+	size_t slab_cnt;            /* Slabs allocated now. */
+	size_t obj_cnt;             /* Objects in use now. */
+	size_t obj_peak;            /* Most objects ever in use at once. */
+
+	struct list_elem elem;      /* Element in all_caches. */
+};
+
+/* Slab: the header at the start of each slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct slab_cache *cache;   /* Owning cache. */
+	size_t free_cnt;            /* Number of free objects. */
+	struct list_elem elem;      /* Element in cache's partial list. */
+	uint64_t free_map[SLAB_MAP_WORDS];  /* 1-bits mark free objects. */
+};
+
+/* Offset of the first object in a slab. */
+#define SLAB_OBJS_OFS ROUND_UP (sizeof (struct slab), SLAB_ALIGN)
+
+/* All slab caches, for statistics. */
+static struct list all_caches;
+static struct lock all_caches_lock;
+
+static struct slab *slab_create (struct slab_cache *);
+static void *slab_to_obj (struct slab_cache *, struct slab *, size_t idx);
+static struct slab *obj_to_slab (struct slab_cache *, void *);
+
+/* Initializes the slab allocator. */
+void
+slab_init (void) {
+	list_init (&all_caches);
+	lock_init (&all_caches_lock);
+}
+
+/* Creates and returns a new cache of objects of SIZE bytes
+   named NAME.  If CTOR is nonnull, it is run on each object when
+   its slab is created.  Returns a null pointer if memory is not
+   available. */
+struct slab_cache *
+slab_cache_create (const char *name, size_t size, slab_ctor_func *ctor) {
+	struct slab_cache *c;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0 && size <= PGSIZE - SLAB_OBJS_OFS);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+
+	c->name = name;
+	c->obj_size = ROUND_UP (size, SLAB_ALIGN);
+	c->objs_per_slab = (PGSIZE - SLAB_OBJS_OFS) / c->obj_size;
+	if (c->objs_per_slab > SLAB_OBJS_MAX)
+		c->objs_per_slab = SLAB_OBJS_MAX;
+	c->ctor = ctor;
+	list_init (&c->partial);
+	lock_init (&c->lock);
+	c->slab_cnt = c->obj_cnt = c->obj_peak = 0;
+
+	lock_acquire (&all_caches_lock);
+	list_push_back (&all_caches, &c->elem);
+	lock_release (&all_caches_lock);
+
+	return c;
+}
+
+/* Destroys cache C, which must have no objects in use. */
+void
+slab_cache_destroy (struct slab_cache *c) {
+	if (c == NULL)
+		return;
+
+	ASSERT (c->obj_cnt == 0);
+
+	lock_acquire (&all_caches_lock);
+	list_remove (&c->elem);
+	lock_release (&all_caches_lock);
+
+	while (!list_empty (&c->partial)) {
+		struct slab *s = list_entry (list_pop_front (&c->partial),
+				struct slab, elem);
+		ASSERT (s->free_cnt == c->objs_per_slab);
+		s->magic = 0;
+		palloc_free_page (s);
+	}
+	free (c);
+}
+
+/* Obtains and returns a new object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c) {
+	struct slab *s;
+	size_t word, bit;
+
+	lock_acquire (&c->lock);
+
+	/* If no slab has a free object, create a new slab. */
+	if (list_empty (&c->partial)) {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	/* Take the first free object of the first slab. */
+	s = list_entry (list_front (&c->partial), struct slab, elem);
+	for (word = 0; s->free_map[word] == 0; word++)
+		ASSERT (word + 1 < SLAB_MAP_WORDS);
+	bit = __builtin_ctzll (s->free_map[word]);
+	s->free_map[word] &= ~(1ULL << bit);
+	if (--s->free_cnt == 0)
+		list_remove (&s->elem);
+
+	if (++c->obj_cnt > c->obj_peak)
+		c->obj_peak = c->obj_cnt;
+
+	lock_release (&c->lock);
+	return slab_to_obj (c, s, word * 64 + bit);
+}
+
+/* Returns OBJ, which must have been obtained from cache C with
+   slab_alloc(), to the cache. */
+void
+slab_free (struct slab_cache *c, void *obj) {
+	struct slab *s;
+	size_t idx;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (c, obj);
+	idx = ((uint8_t *) obj - ((uint8_t *) s + SLAB_OBJS_OFS)) / c->obj_size;
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs.  We
+	   can't do that if the object must stay constructed. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->obj_size);
+#endif
+
+	lock_acquire (&c->lock);
+
+	ASSERT ((s->free_map[idx / 64] & (1ULL << (idx % 64))) == 0);
+	s->free_map[idx / 64] |= 1ULL << (idx % 64);
+	if (s->free_cnt++ == 0)
+		list_push_front (&c->partial, &s->elem);
+	c->obj_cnt--;
+
+	/* If the slab is now entirely unused, and another slab has
+	   free objects, free it. */
+	if (s->free_cnt == c->objs_per_slab
+			&& (list_front (&c->partial) != &s->elem
+				|| list_next (&s->elem) != list_end (&c->partial))) {
+		list_remove (&s->elem);
+		s->magic = 0;
+		palloc_free_page (s);
+		c->slab_cnt--;
+	}
+
+	lock_release (&c->lock);
+}
+
+/* Prints utilization statistics for every slab cache. */
+void
+slab_print_stats (void) {
+	struct list_elem *e;
+
+	lock_acquire (&all_caches_lock);
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+		size_t bytes = c->slab_cnt * PGSIZE;
+
+		printf ("Slab %s: %zu objects of %zu bytes (peak %zu) "
+				"in %zu slabs, %zu%% used\n",
+				c->name, c->obj_cnt, c->obj_size, c->obj_peak, c->slab_cnt,
+				bytes > 0 ? c->obj_cnt * c->obj_size * 100 / bytes : 0);
+	}
+	lock_release (&all_caches_lock);
+}
+
+/* Creates a new slab for cache C, with all of its objects free
+   and constructed.  Returns a null pointer if memory is not
+   available. */
+static struct slab *
+slab_create (struct slab_cache *c) {
+	struct slab *s;
+	size_t i;
+
+	s = palloc_get_page (0);
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free_cnt = c->objs_per_slab;
+	memset (s->free_map, 0, sizeof s->free_map);
+	for (i = 0; i < c->objs_per_slab; i++)
+		s->free_map[i / 64] |= 1ULL << (i % 64);
+	if (c->ctor != NULL)
+		for (i = 0; i < c->objs_per_slab; i++)
+			c->ctor (slab_to_obj (c, s, i));
+	c->slab_cnt++;
+
+	return s;
+}
+
+/* Returns the IDX'th object within slab S of cache C. */
+static void *
+slab_to_obj (struct slab_cache *c, struct slab *s, size_t idx) {
+	ASSERT (idx < c->objs_per_slab);
+	return (uint8_t *) s + SLAB_OBJS_OFS + idx * c->obj_size;
+}
+
+/* Returns the slab of cache C that OBJ is inside. */
+static struct slab *
+obj_to_slab (struct slab_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	/* Check that the slab is valid. */
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT (pg_ofs (obj) >= SLAB_OBJS_OFS);
+	ASSERT ((pg_ofs (obj) - SLAB_OBJS_OFS) % c->obj_size == 0);
+
+	return s;
+}
@@ -32,7 +32,82 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
-#define DEPTH 8
+static void lock_set_holder (struct lock *);
+static void lock_update_priority (struct lock *);
+static bool donor_priority_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static bool waiter_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+
+/* Initializes QUEUE as an empty wait queue. */
+void
+wait_queue_init (struct wait_queue *queue) {
+	ASSERT (queue != NULL);
+
+	heap_init (&queue->heap, waiter_less, NULL);
+	queue->next_seq = 0;
+}
+
+/* Adds T, which is about to block, to QUEUE behind the threads of
+   its priority already waiting.  Interrupts must be off. */
+void
+wait_queue_push (struct wait_queue *queue, struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->wait_queue == NULL);
+
+	t->wait_queue = queue;
+	t->wait_seq = queue->next_seq++;
+	heap_push (&queue->heap, &t->wait_elem);
+}
+
+/* Removes and returns the first thread in QUEUE, or a null
+   pointer if QUEUE is empty.  Interrupts must be off. */
+struct thread *
+wait_queue_pop (struct wait_queue *queue) {
+	struct thread *t;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (heap_empty (&queue->heap))
+		return NULL;
+	t = heap_entry (heap_pop (&queue->heap), struct thread, wait_elem);
+	t->wait_queue = NULL;
+	return t;
+}
+
+/* Moves T, which is in a wait queue, to its place for its current
+   priority.  Interrupts must be off. */
+void
+wait_queue_requeue (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->wait_queue != NULL);
+
+	heap_update (&t->wait_queue->heap, &t->wait_elem);
+}
+
+/* Returns true if no thread is waiting in QUEUE. */
+bool
+wait_queue_empty (const struct wait_queue *queue) {
+	return heap_empty (&queue->heap);
+}
+
+/* Returns the number of threads waiting in QUEUE. */
+size_t
+wait_queue_size (const struct wait_queue *queue) {
+	return heap_size (&queue->heap);
+}
+
+/* Orders waiting threads by priority, then by arrival. */
+static bool
+waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+	const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+	return a->wait_seq > b->wait_seq;
+}
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -48,7 +123,7 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	wait_queue_init (&sema->waiters);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,8 +143,7 @@ sema_down (struct semaphore *sema) {
 
 	old_level = intr_disable ();
 	while (sema->value == 0) {
-		// list_push_back (&sema->waiters, &thread_current ()->elem);
-		list_insert_ordered (&sema->waiters, &thread_current ()->elem, thread_priority_comparator, 0);
+		wait_queue_push (&sema->waiters, thread_current ());
 		thread_block ();
 	}
 	sema->value--;
@@ -113,11 +187,8 @@ sema_up (struct semaphore *sema) {
 
 	old_level = intr_disable ();
 	sema->value++;
-	if (!list_empty (&sema->waiters)) {
-		list_sort (&sema->waiters, thread_priority_comparator, 0);
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
-	}
+	if (!wait_queue_empty (&sema->waiters))
+		thread_unblock (wait_queue_pop (&sema->waiters));
 	intr_set_level (old_level);
 }
 
@@ -177,6 +248,8 @@ lock_init (struct lock *lock) {
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	heap_init (&lock->waiters, donor_priority_less, NULL);
+	lock->priority = PRI_MIN - 1;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -189,45 +262,25 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	if (!thread_mlfqs) {
-		/* Donate Priority */
-		// if (lock->holder) 
-		// 	lock->holder->priority = thread_current ()->priority;
-
-		/* Donate Priority - add Nested Version */
+	old_level = intr_disable ();
+	if (!thread_mlfqs && lock->holder != NULL) {
+		/* Donate Priority: wait as one of LOCK's donors until we
+		   get it. */
 		struct thread *curr = thread_current ();
-		curr->wait_on_lock = lock;
-		
-		// if (lock->holder) {
-		// 	for (int i=0; i<DEPTH; i++) {
-		// 		if (curr->wait_on_lock) {
-		// 			curr->wait_on_lock->holder->priority = curr->priority;
-		// 			curr = curr->wait_on_lock->holder;
-		// 		}
-		// 		else break;
-		// 	}
-		// }
-
-		/* Donate Priority - add Multiple Version */
-		if (lock->holder) {
-			list_insert_ordered(&lock->holder->donations, &curr->donation_elem, thread_donation_priority_comparator, 0);
-			for (int i=0; i<DEPTH; i++) {
-				if (curr->wait_on_lock) {
-					curr->wait_on_lock->holder->priority = curr->priority;
-					curr = curr->wait_on_lock->holder;
-				}
-				else break;
-			}
-		}
 
-		curr->wait_on_lock = NULL;
+		curr->wait_on_lock = lock;
+		heap_push (&lock->waiters, &curr->donor_elem);
+		lock_update_priority (lock);
 	}
 	sema_down (&lock->semaphore);
-	lock->holder = thread_current ();
+	lock_set_holder (lock);
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -238,14 +291,17 @@ lock_acquire (struct lock *lock) {
    interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
 	if (success)
-		lock->holder = thread_current ();
+		lock_set_holder (lock);
+	intr_set_level (old_level);
 	return success;
 }
 
@@ -257,29 +313,21 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	lock->holder = NULL;
-	
 	if (!thread_mlfqs) {
-		/* Donate Priority */
-		struct thread *curr = thread_current ();
-		// curr->priority = curr->original_priority;
-		
-		/* Donate Priority - add Multiple Version */
-		struct list_elem *e;
-		for (e = list_begin (&curr->donations); e != list_end (&curr->donations); e = list_next (e)) {
-			struct thread *donator = list_entry (e, struct thread, donation_elem);
-			if (donator->wait_on_lock == lock) {
-				list_remove (&donator->donation_elem);
-			}
-		}
-
-		curr->priority = curr->original_priority;
+		/* The threads still waiting for LOCK donate to its next
+		   holder instead of us. */
+		heap_remove (&thread_current ()->held_locks, &lock->holder_elem);
 		check_donation ();
 	}
 	sema_up (&lock->semaphore);
+	intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -292,11 +340,224 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
+/* Makes the running thread, which just took LOCK's semaphore,
+   LOCK's holder.  If it was waiting for LOCK, it stops donating to
+   LOCK, and the other waiters donate to it from now on. */
+static void
+lock_set_holder (struct lock *lock) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	lock->holder = curr;
+	if (thread_mlfqs)
+		return;
+
+	if (curr->wait_on_lock == lock) {
+		heap_remove (&lock->waiters, &curr->donor_elem);
+		curr->wait_on_lock = NULL;
+	}
+	lock->priority = heap_empty (&lock->waiters) ? PRI_MIN - 1
+		: heap_entry (heap_top (&lock->waiters), struct thread,
+				donor_elem)->priority;
+	heap_push (&curr->held_locks, &lock->holder_elem);
+	thread_change_priority (curr, thread_effective_priority (curr));
+}
+
+/* Recomputes the priority that LOCK donates after its waiters
+   changed, and carries the change along the chain of holders:
+   LOCK's holder, the holder of the lock that thread is waiting
+   for, and so on.  Stops as soon as a priority does not change,
+   so the chain may be of any length. */
+static void
+lock_update_priority (struct lock *lock) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (lock != NULL) {
+		struct thread *holder = lock->holder;
+		int priority = heap_empty (&lock->waiters) ? PRI_MIN - 1
+			: heap_entry (heap_top (&lock->waiters), struct thread,
+					donor_elem)->priority;
+
+		if (priority == lock->priority)
+			break;
+		lock->priority = priority;
+		if (holder == NULL)
+			break;
+
+		heap_update (&holder->held_locks, &lock->holder_elem);
+		priority = thread_effective_priority (holder);
+		if (priority == holder->priority)
+			break;
+		thread_change_priority (holder, priority);
+
+		lock = holder->wait_on_lock;
+		if (lock != NULL)
+			heap_update (&lock->waiters, &holder->donor_elem);
+	}
+}
+
+/* Orders threads waiting for a lock by priority. */
+static bool
+donor_priority_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, donor_elem)->priority
+		< heap_entry (b, struct thread, donor_elem)->priority;
+}
+
+/* Orders the locks a thread holds by the priority they donate. */
+bool
+lock_priority_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct lock, holder_elem)->priority
+		< heap_entry (b, struct lock, holder_elem)->priority;
+}
+
+/* Initializes RW as a reader-writer lock held by nobody. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	rw->readers = 0;
+	rw->writer_waiting = false;
+	sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping until no writer holds or is
+   waiting for it if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	rw->readers++;
+	intr_set_level (old_level);
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   The last reader to leave lets a waiting writer in.
+
+   This function may be called from an interrupt handler. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (rw->readers > 0);
+	if (--rw->readers == 0 && rw->writer_waiting) {
+		rw->writer_waiting = false;
+		sema_up (&rw->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it if necessary.  The rwlock must not already be held by the
+   current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	/* Holding LOCK keeps new readers out while the current ones
+	   drain. */
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	if (rw->readers > 0) {
+		rw->writer_waiting = true;
+		sema_down (&rw->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which must be held for writing by the current
+   thread. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_held_for_write (rw));
+
+	lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return lock_held_by_current_thread (&rw->lock) && rw->readers == 0;
+}
+
+/* Initializes SEQ with no write in progress. */
+void
+seqlock_init (struct seqlock *seq) {
+	ASSERT (seq != NULL);
+
+	seq->seq = 0;
+}
+
+/* Begins a read of the record protected by SEQ, waiting for a
+   write in progress to end, and returns the value to pass to
+   seqlock_read_retry() once the record has been read. */
+unsigned
+seqlock_read_begin (const struct seqlock *seq) {
+	unsigned start;
+
+	ASSERT (seq != NULL);
+
+	while ((start = __atomic_load_n (&seq->seq, __ATOMIC_ACQUIRE)) & 1)
+		asm volatile ("pause");
+	return start;
+}
+
+/* Ends a read of the record protected by SEQ begun when
+   seqlock_read_begin() returned START.  Returns true if a write
+   overlapped the read, in which case the values read must be
+   discarded and the read retried. */
+bool
+seqlock_read_retry (const struct seqlock *seq, unsigned start) {
+	ASSERT (seq != NULL);
+
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	return seq->seq != start;
+}
+
+/* Begins a write of the record protected by SEQ. */
+void
+seqlock_write_begin (struct seqlock *seq) {
+	ASSERT (seq != NULL);
+	ASSERT ((seq->seq & 1) == 0);
+
+	seq->seq++;
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+/* Ends a write of the record protected by SEQ. */
+void
+seqlock_write_end (struct seqlock *seq) {
+	ASSERT (seq != NULL);
+	ASSERT ((seq->seq & 1) != 0);
+
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	seq->seq++;
+}
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -305,7 +566,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	wait_queue_init (&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -330,30 +591,25 @@ cond_init (struct condition *cond) {
    we need to sleep. */
 void
 cond_wait (struct condition *cond, struct lock *lock) {
-	struct semaphore_elem waiter;
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	sema_init (&waiter.semaphore, 0);
-	// list_push_back (&cond->waiters, &waiter.elem);
-	list_insert_ordered (&cond->waiters, &waiter.elem, sema_priority_comparator, 0);
+	old_level = intr_disable ();
+	wait_queue_push (&cond->waiters, curr);
 	lock_release (lock);
-	sema_down (&waiter.semaphore);
-	lock_acquire (lock);
-}
-
-bool 
-sema_priority_comparator (const struct list_elem *l, const struct list_elem *r, void *aux UNUSED) {
-	struct list l_waiters = list_entry (l, struct semaphore_elem, elem)->semaphore.waiters;
-	struct list r_waiters = list_entry (r, struct semaphore_elem, elem)->semaphore.waiters;
 
-	if (list_entry(list_begin (&l_waiters), struct thread, elem)->priority <= list_entry(list_begin (&r_waiters), struct thread, elem)->priority)
-		return false;
-	else 
-		return true;
+	/* Releasing LOCK may have let a higher-priority thread run
+	   before we got to block, and it may already have signaled
+	   us. */
+	if (curr->wait_queue == &cond->waiters)
+		thread_block ();
+	intr_set_level (old_level);
+	lock_acquire (lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
@@ -365,16 +621,19 @@ sema_priority_comparator (const struct list_elem *l, const struct list_elem *r,
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) {
+	enum intr_level old_level;
+	struct thread *t;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)) {
-		list_sort (&cond->waiters, sema_priority_comparator, 0);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
-	}
+	old_level = intr_disable ();
+	t = wait_queue_pop (&cond->waiters);
+	if (t != NULL && t->status == THREAD_BLOCKED)
+		thread_unblock (t);
+	intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -388,6 +647,6 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!wait_queue_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
@@ -1,6 +1,7 @@
 #include "threads/fixed_point.h"
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -9,8 +10,10 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -25,13 +28,53 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
  
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* List of processes in THREAD_BLOCKED state, that is, processes
-	that are in sleep for a given ticks. */
-static struct list sleep_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO list per priority level, and bit P of
+   ready_mask is set iff ready_queues[P] is nonempty, so that
+   enqueue, dequeue and finding the highest ready priority are
+   all constant time. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static size_t ready_cnt;        /* # of threads in the run queue. */
+
+/* Processes in THREAD_BLOCKED state that are sleeping until a
+   given tick, kept on a two-level hierarchical timer wheel keyed
+   on the wake-up tick.  A thread due within WHEEL0_SIZE ticks
+   sits in the level-0 slot of its exact tick; one due within
+   WHEEL0_SIZE * WHEEL1_SIZE ticks sits in the level-1 slot of its
+   WHEEL0_SIZE-tick window and is moved down ("cascaded") when
+   that window starts; anything later waits on sleep_overflow
+   until level 1 wraps around.  Each tick therefore only looks at
+   threads that are actually due, plus an amortized constant
+   amount of cascading. */
+#define WHEEL0_BITS 8
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEEL1_BITS 6
+#define WHEEL1_SIZE (1 << WHEEL1_BITS)
+static struct list sleep_wheel0[WHEEL0_SIZE];
+static struct list sleep_wheel1[WHEEL1_SIZE];
+static struct list sleep_overflow;
+static int64_t sleep_wheel_next;   /* First tick not yet processed. */
+
+/* List of all processes.  Processes are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
+
+/* For Advanced Scheduler: threads whose recent_cpu or nice is
+   nonzero, and threads whose priority has to be recalculated. */
+static struct list mlfqs_list;
+static struct list mlfqs_stale_list;
+
+/* Pages of dead threads kept for reuse by thread_create(), so
+   that process turnover does not go through the page allocator
+   and clear a whole page each time.  Linked through their `elem'
+   members.  Accessed with interrupts off. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+static long long thread_pages_reused;     /* Pages taken from the cache. */
+static long long thread_pages_allocated;  /* Pages from palloc. */
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -50,10 +93,17 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Scheduler latency statistics, per priority level. */
+static struct sched_prio_stats prio_stats[PRI_MAX + 1];
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Offset of `stack' member within `struct thread'.
+   Used by switch.S, which can't figure it out on its own. */
+uint32_t thread_stack_ofs = offsetof (struct thread, stack);
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -63,8 +113,21 @@ int load_avg;
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void sleep_wheel_insert (struct thread *);
+static void sleep_wheel_cascade (void);
+static void mlfqs_touch (struct thread *);
+static void sched_hist_add (struct sched_hist *, uint64_t);
+static void sched_hist_print (const char *name, const struct sched_hist *);
+static void sched_account (struct thread *curr, struct thread *next);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static void *alloc_frame (struct thread *, size_t size);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static void thread_forget (struct thread *);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
@@ -80,6 +143,7 @@ static tid_t allocate_tid (void);
 #define running_thread() ((struct thread *) (pg_round_down (rrsp ())))
 
 
+
 // Global descriptor table for the thread_start.
 // Because the gdt will be setup after the thread_init, we should
 // setup temporal gdt first.
@@ -113,14 +177,24 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list);
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&ready_queues[pri]);
+	for (int i = 0; i < WHEEL0_SIZE; i++)
+		list_init (&sleep_wheel0[i]);
+	for (int i = 0; i < WHEEL1_SIZE; i++)
+		list_init (&sleep_wheel1[i]);
+	list_init (&sleep_overflow);
+	list_init (&all_list);
+	list_init (&mlfqs_list);
+	list_init (&mlfqs_stale_list);
+	list_init (&thread_cache);
 	list_init (&destruction_req);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
+	initial_thread->run_stamp = rdtsc ();
 	initial_thread->tid = allocate_tid ();
 }
 
@@ -151,28 +225,88 @@ void thread_sleep (int64_t ticks) {
 	old_level = intr_disable (); // disable interrupt
 	if (curr != idle_thread) {
 		curr->ticks = ticks;
-		list_push_back(&sleep_list, &curr->elem);
+		sleep_wheel_insert (curr);
 		thread_block(); // 현재 thread를 block 상태로 만들기
 	} 
 	intr_set_level (old_level); // interrupt disable 해제
 }
 
 void thread_awake (int64_t ticks) {
-	/* Awake Thread if ticks is over */
-	if (!list_empty (&sleep_list)) {
-		struct list_elem *e = list_begin (&sleep_list);
-
-		while (e != list_end (&sleep_list)) {
-			struct thread *sleep_thread = list_entry(e, struct thread, elem);
-			if (sleep_thread->ticks <= ticks) {
-				e = list_remove (e);
-				thread_unblock (sleep_thread); // Unblock -> ready_list에 집어넣기
-			}
-			else {
-				e = list_next (e);
-			}
+	/* Awake threads of every tick up to TICKS that the wheel has
+	   not processed yet. */
+	while (sleep_wheel_next <= ticks) {
+		struct list *slot = &sleep_wheel0[sleep_wheel_next & (WHEEL0_SIZE - 1)];
+
+		if ((sleep_wheel_next & (WHEEL0_SIZE - 1)) == 0)
+			sleep_wheel_cascade ();
+		while (!list_empty (slot)) {
+			struct thread *sleep_thread = list_entry (list_pop_front (slot), struct thread, elem);
+			ASSERT (sleep_thread->ticks <= ticks);
+			thread_unblock (sleep_thread); // Unblock -> ready queue에 집어넣기
 		}
+		sleep_wheel_next++;
+	}
+}
+
+/* Returns the earliest tick, no later than LIMIT, on which a
+   sleeping thread may have to be woken up, or LIMIT if there is
+   none.  Only level 0 of the wheel is examined, so the start of
+   the next WHEEL0_SIZE-tick window, where a cascade may bring new
+   threads down, is also treated as a possible wake-up. */
+int64_t
+thread_next_wakeup (int64_t limit) {
+	int64_t t;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (t = sleep_wheel_next; t < limit; t++) {
+		if (t != sleep_wheel_next && (t & (WHEEL0_SIZE - 1)) == 0)
+			return t;
+		if (!list_empty (&sleep_wheel0[t & (WHEEL0_SIZE - 1)]))
+			return t;
 	}
+	return limit;
+}
+
+/* Puts sleeping thread T on the slot of the timer wheel that
+   matches its wake-up tick.  A thread whose tick has already been
+   processed wakes up on the next one. */
+static void
+sleep_wheel_insert (struct thread *t) {
+	int64_t expires = t->ticks > sleep_wheel_next ? t->ticks : sleep_wheel_next;
+	int64_t delta = expires - sleep_wheel_next;
+	struct list *slot;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (delta < WHEEL0_SIZE)
+		slot = &sleep_wheel0[expires & (WHEEL0_SIZE - 1)];
+	else if (delta < WHEEL0_SIZE * WHEEL1_SIZE)
+		slot = &sleep_wheel1[(expires >> WHEEL0_BITS) & (WHEEL1_SIZE - 1)];
+	else
+		slot = &sleep_overflow;
+	list_push_back (slot, &t->elem);
+}
+
+/* Called at the start of every WHEEL0_SIZE-tick window: moves the
+   threads of the level-1 slot for this window down to level 0,
+   and, once per level-1 revolution, redistributes the overflow
+   list. */
+static void
+sleep_wheel_cascade (void) {
+	size_t idx = (sleep_wheel_next >> WHEEL0_BITS) & (WHEEL1_SIZE - 1);
+	struct list pending;
+
+	list_init (&pending);
+	if (!list_empty (&sleep_wheel1[idx]))
+		list_splice (list_end (&pending), list_begin (&sleep_wheel1[idx]),
+				list_end (&sleep_wheel1[idx]));
+	if (idx == 0 && !list_empty (&sleep_overflow))
+		list_splice (list_end (&pending), list_begin (&sleep_overflow),
+				list_end (&sleep_overflow));
+
+	while (!list_empty (&pending))
+		sleep_wheel_insert (list_entry (list_pop_front (&pending), struct thread, elem));
 }
 
 /* Called by the timer interrupt handler at each timer tick.
@@ -191,9 +325,13 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
-	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	/* Enforce preemption.  The idle thread has no time slice: it
+	   blocks as soon as it wakes up, and it may be charged for the
+	   ticks it skipped outside of the timer interrupt. */
+	if (t != idle_thread && ++thread_ticks >= TIME_SLICE) {
+		t->preempted = true;
 		intr_yield_on_return ();
+	}
 }
 
 /* Prints thread statistics. */
@@ -201,6 +339,121 @@ void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	printf ("Thread: %lld pages reused, %lld pages allocated\n",
+			thread_pages_reused, thread_pages_allocated);
+
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++) {
+		const struct sched_prio_stats *ps = &prio_stats[pri];
+
+		if (ps->runnable.cnt == 0 && ps->slice.cnt == 0)
+			continue;
+		printf ("Priority %d: %"PRIu64" voluntary, "
+				"%"PRIu64" involuntary switches\n", pri, ps->voluntary, ps->involuntary);
+		sched_hist_print ("wakeup latency", &ps->wakeup);
+		sched_hist_print ("runnable wait", &ps->runnable);
+		sched_hist_print ("time slice", &ps->slice);
+	}
+
+	for (struct list_elem *e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		const struct thread *t = list_entry (e, struct thread, all_elem);
+		const struct sched_thread_stats *ts = &t->stats;
+
+		printf ("Thread %s: %"PRIu64" wakeups "
+				"(avg %"PRIu64", max %"PRIu64" cycles), %"PRIu64" cycles run, "
+				"%"PRIu64" voluntary, %"PRIu64" involuntary switches\n",
+				t->name, ts->wakeup_cnt,
+				ts->wakeup_cnt > 0 ? ts->wakeup_sum / ts->wakeup_cnt : 0,
+				ts->wakeup_max, ts->run_sum, ts->voluntary, ts->involuntary);
+	}
+}
+
+/* Copies the scheduler statistics of the running thread and of
+   priority level PRIORITY, or of the running thread's priority if
+   PRIORITY is -1, into STATS.  Returns false if PRIORITY is out of
+   range. */
+bool
+thread_get_sched_stats (int priority, struct sched_stats *stats) {
+	enum intr_level old_level;
+
+	if (priority == -1)
+		priority = thread_get_priority ();
+	if (priority < PRI_MIN || priority > PRI_MAX)
+		return false;
+
+	old_level = intr_disable ();
+	stats->thread = thread_current ()->stats;
+	stats->prio = prio_stats[priority];
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Adds a sample of CYCLES to histogram H. */
+static void
+sched_hist_add (struct sched_hist *h, uint64_t cycles) {
+	int b = 63 - __builtin_clzll (cycles | 1);
+
+	h->buckets[b < SCHEDSTAT_BUCKETS ? b : SCHEDSTAT_BUCKETS - 1]++;
+	h->cnt++;
+	h->sum += cycles;
+	if (cycles > h->max)
+		h->max = cycles;
+}
+
+/* Prints histogram H, labeled NAME, as its nonempty buckets. */
+static void
+sched_hist_print (const char *name, const struct sched_hist *h) {
+	if (h->cnt == 0)
+		return;
+
+	printf ("  %s: %"PRIu64" samples, avg %"PRIu64", max %"PRIu64" cycles; "
+			"log2 buckets",
+			name, h->cnt, h->sum / h->cnt, h->max);
+	for (int b = 0; b < SCHEDSTAT_BUCKETS; b++)
+		if (h->buckets[b] != 0)
+			printf (" %d:%u", b, h->buckets[b]);
+	printf ("\n");
+}
+
+/* Records the switch from CURR to NEXT in the scheduler
+   statistics: how long CURR ran and why it stopped, and how long
+   NEXT waited to run.  The idle thread is not accounted for. */
+static void
+sched_account (struct thread *curr, struct thread *next) {
+	uint64_t now = rdtsc ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (curr != idle_thread) {
+		struct sched_prio_stats *ps = &prio_stats[curr->priority];
+		uint64_t ran = now - curr->run_stamp;
+
+		sched_hist_add (&ps->slice, ran);
+		curr->stats.run_sum += ran;
+		if (curr->status == THREAD_READY && curr->preempted) {
+			ps->involuntary++;
+			curr->stats.involuntary++;
+		} else {
+			ps->voluntary++;
+			curr->stats.voluntary++;
+		}
+	}
+	curr->preempted = false;
+
+	if (next != idle_thread) {
+		struct sched_prio_stats *ps = &prio_stats[next->priority];
+		uint64_t waited = now - next->ready_stamp;
+
+		sched_hist_add (&ps->runnable, waited);
+		if (next->woken) {
+			sched_hist_add (&ps->wakeup, waited);
+			next->stats.wakeup_cnt++;
+			next->stats.wakeup_sum += waited;
+			if (waited > next->stats.wakeup_max)
+				next->stats.wakeup_max = waited;
+		}
+	}
+	next->run_stamp = now;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -221,13 +474,14 @@ thread_print_stats (void) {
 tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
+	struct switch_threads_frame *sf;
 	struct thread *t;
 	tid_t tid;
 
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = thread_page_get ();
 	if (t == NULL)
 		return TID_ERROR;
 
@@ -235,16 +489,15 @@ thread_create (const char *name, int priority,
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
 
-	/* Call the kernel_thread if it scheduled.
-	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
-	t->tf.rip = (uintptr_t) kernel_thread;
-	t->tf.R.rdi = (uint64_t) function;
-	t->tf.R.rsi = (uint64_t) aux;
-	t->tf.ds = SEL_KDSEG;
-	t->tf.es = SEL_KDSEG;
-	t->tf.ss = SEL_KDSEG;
-	t->tf.cs = SEL_KCSEG;
-	t->tf.eflags = FLAG_IF;
+	/* Stack frame for switch_threads(), which "returns" into
+	   switch_entry(), which in turn calls kernel_thread (FUNCTION,
+	   AUX). */
+	sf = alloc_frame (t, sizeof *sf);
+	sf->rip = switch_entry;
+	sf->r12 = (uint64_t) function;
+	sf->r13 = (uint64_t) aux;
+	sf->r14 = (uint64_t) kernel_thread;
+	sf->rbp = 0;
 
 	/* Add to run queue. */
 	thread_unblock (t);
@@ -291,8 +544,9 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	// list_push_back (&ready_list, &t->elem);
-	list_insert_ordered (&ready_list, &t->elem, thread_priority_comparator, 0);
+	t->ready_stamp = rdtsc ();
+	t->woken = true;
+	ready_queue_push (t);
 	t->status = THREAD_READY;
  
 	if (thread_current () != idle_thread)
@@ -340,9 +594,11 @@ thread_exit (void) {
 	process_exit ();
 #endif
 
-	/* Just set our status to dying and schedule another process.
-	   We will be destroyed during the call to schedule_tail(). */
+	/* Remove thread from all threads list, set our status to dying,
+	   and schedule another process.  That process will destroy us
+	   when it calls do_schedule(). */
 	intr_disable ();
+	thread_forget (thread_current ());
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -357,9 +613,11 @@ thread_yield (void) {
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
-	if (curr != idle_thread)
-		// list_push_back (&ready_list, &curr->elem);
-		list_insert_ordered(&ready_list, &curr->elem, thread_priority_comparator, 0);
+	if (curr != idle_thread) {
+		curr->ready_stamp = rdtsc ();
+		curr->woken = false;
+		ready_queue_push (curr);
+	}
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
 }
@@ -368,39 +626,72 @@ thread_yield (void) {
 void
 thread_set_priority (int new_priority) {
 	if (!thread_mlfqs) {
-		thread_current ()->priority = new_priority;
-		thread_current ()->original_priority = new_priority;
+		enum intr_level old_level = intr_disable ();
 
+		thread_current ()->original_priority = new_priority;
 		check_donation ();
+		intr_set_level (old_level);
 		check_priority ();
 	}
 }
 
+/* Changes T's priority to PRIORITY, moving T to the matching run
+   queue if it is ready, and to its new place in the wait queue it
+   is on, if any.  A thread can be on both: cond_wait() queues the
+   thread before releasing the lock, which may preempt it.  Does
+   not preempt the running thread. */
+void
+thread_change_priority (struct thread *t, int priority) {
+	enum intr_level old_level = intr_disable ();
+
+	if (t->priority != priority) {
+		if (t->status == THREAD_READY) {
+			ready_queue_remove (t);
+			t->priority = priority;
+			ready_queue_push (t);
+		} else
+			t->priority = priority;
+		if (t->wait_queue != NULL)
+			wait_queue_requeue (t);
+	}
+	intr_set_level (old_level);
+}
+
 /* Check current thread is still on the highest priority */
 void
 check_priority (void) {
-	struct thread *curr = thread_current ();
-
-	if (!list_empty (&ready_list)) {
-		struct list_elem *e = list_begin (&ready_list);
-		struct thread *first_ready_thread = list_entry(e, struct thread, elem);
-		
-		if (first_ready_thread->priority > curr->priority) {
+	if (ready_queue_max_priority () > thread_current ()->priority) {
+		thread_current ()->preempted = true;
+		if (intr_context ())
+			intr_yield_on_return ();
+		else
 			thread_yield ();
-		}
 	}
 }
 
-/* Check donation when the priority of accepter thread has been changed */
+/* Recomputes the running thread's priority after its own priority
+   or the set of locks it holds changed. */
 void
 check_donation (void) {
 	struct thread *curr = thread_current ();
 
-	if (!list_empty (&curr->donations)) {
-		list_sort (&curr->donations, thread_priority_comparator, 0);
-		struct thread *donator_with_highest_priority = list_entry (list_begin (&curr->donations), struct thread, donation_elem);
-		curr->priority = donator_with_highest_priority->priority; 
+	thread_change_priority (curr, thread_effective_priority (curr));
+}
+
+/* Returns T's priority with donations: the greater of its own
+   priority and the highest priority of a thread waiting for a
+   lock T holds. */
+int
+thread_effective_priority (struct thread *t) {
+	int priority = t->original_priority;
+
+	if (!heap_empty (&t->held_locks)) {
+		struct lock *lock =
+			heap_entry (heap_top (&t->held_locks), struct lock, holder_elem);
+		if (lock->priority > priority)
+			priority = lock->priority;
 	}
+	return priority;
 }
 
 /* Returns the current thread's priority. */
@@ -411,23 +702,6 @@ thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
-/* Priority Comparator */
-bool
-thread_priority_comparator (const struct list_elem *l, const struct list_elem *r, void *aux UNUSED) {
-	if (list_entry(l, struct thread, elem)->priority <= list_entry(r, struct thread, elem)->priority)
-		return false;
-	else 
-		return true;
-}
-
-bool
-thread_donation_priority_comparator (const struct list_elem *l, const struct list_elem *r, void *aux UNUSED) {
-	if (list_entry(l, struct thread, donation_elem)->priority <= list_entry(r, struct thread, donation_elem)->priority)
-		return false;
-	else 
-		return true;
-}
-
 void
 update_recent_cpu (bool curr) {
 	// On each timer tick, the running thread's recent cpu is incremented by 1. 
@@ -435,70 +709,84 @@ update_recent_cpu (bool curr) {
 		struct thread *t = thread_current ();
 		if (t != idle_thread) {
 			t->recent_cpu = add_x_and_n (t->recent_cpu, 1);
+			mlfqs_touch (t);
 		}
 	}
-	// Once per second, every thread's recent cpu is updated
+	// Once per second, every thread's recent cpu is updated.  A thread
+	// with zero recent cpu and zero nice keeps zero recent cpu, so only
+	// the threads on mlfqs_list have to be visited.
 	else {
-		if (!list_empty (&ready_list)) {
-			struct list_elem *e;
-			for (e=list_front (&ready_list); e!=list_end (&ready_list); e=list_next (e)) {
-				struct thread *t = list_entry (e, struct thread, elem);
-				// t->recent_cpu = (2*load_avg) / (2*load_avg+1) * (t->recent_cpu) + t->nice;
-				thread_update_recent_cpu (t);			
-			}
-		}
+		int coef = div_x_by_y (mul_x_by_n (load_avg, 2), add_x_and_n (mul_x_by_n (load_avg, 2), 1));
+		struct list_elem *e = list_begin (&mlfqs_list);
 
-		if (!list_empty (&sleep_list)) {
-			struct list_elem *e;
-			for (e=list_front (&sleep_list); e!=list_end (&sleep_list); e=list_next (e)) {
-				struct thread *t = list_entry (e, struct thread, elem);
-				// t->recent_cpu = (2*load_avg) / (2*load_avg+1) * (t->recent_cpu) + t->nice;
-				thread_update_recent_cpu (t);			
-			}
-		}
+		while (e != list_end (&mlfqs_list)) {
+			struct thread *t = list_entry (e, struct thread, mlfqs_elem);
+			e = list_next (e);
 
-		thread_update_recent_cpu (thread_current ());
+			// t->recent_cpu = (2*load_avg) / (2*load_avg+1) * (t->recent_cpu) + t->nice;
+			t->recent_cpu = add_x_and_n (mul_x_by_y (coef, t->recent_cpu), t->nice);
+			mlfqs_touch (t);
+		}
 	}
 }
 
-void 
-thread_update_recent_cpu (struct thread *t) {
-	t->recent_cpu = add_x_and_n (mul_x_by_y (div_x_by_y (mul_x_by_n (load_avg, 2), add_x_and_n (mul_x_by_n (load_avg, 2), 1)), t->recent_cpu), t->nice);
-} 
-
+/* Recalculates the priority of every thread whose recent cpu or
+   nice changed since the last recalculation.  The priority of
+   any other thread would come out the same. */
 void
 recalculate_priority (void) {
-	// recalculate priority according to given rule
-	if (!list_empty (&ready_list)) {
-		struct list_elem *e;
-		for (e=list_front (&ready_list); e!=list_end (&ready_list); e=list_next (e)) {
-			struct thread *t = list_entry (e, struct thread, elem);
-			thread_recalculate_priority (t);
-		}
-	}
-
-	if (!list_empty (&sleep_list)) {
-		struct list_elem *e;
-		for (e=list_front (&sleep_list); e!=list_end (&sleep_list); e=list_next (e)) {
-			struct thread *t = list_entry (e, struct thread, elem);
-			thread_recalculate_priority (t);
-		}
+	while (!list_empty (&mlfqs_stale_list)) {
+		struct thread *t = list_entry (list_pop_front (&mlfqs_stale_list),
+				struct thread, mlfqs_stale_elem);
+		t->mlfqs_stale = false;
+		thread_recalculate_priority (t);
 	}
-
-	thread_recalculate_priority (thread_current ());
 }
 
 void
 thread_recalculate_priority (struct thread *t) {
-	if (t != idle_thread)
-		t->priority = convert_x_to_int (mul_x_by_n (add_x_and_n (sub_n_from_x (div_x_by_n (t->recent_cpu, 4), PRI_MAX), t->nice*2), -1));
+	int priority;
+
+	if (t == idle_thread)
+		return;
+
+	priority = convert_x_to_int (mul_x_by_n (add_x_and_n (sub_n_from_x (div_x_by_n (t->recent_cpu, 4), PRI_MAX), t->nice*2), -1));
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	thread_change_priority (t, priority);
+}
+
+/* Notes that T's recent cpu or nice may have changed: queues T
+   for the next priority recalculation, and keeps T on mlfqs_list
+   exactly as long as either value is nonzero. */
+static void
+mlfqs_touch (struct thread *t) {
+	enum intr_level old_level = intr_disable ();
+
+	if (!t->mlfqs_stale) {
+		t->mlfqs_stale = true;
+		list_push_back (&mlfqs_stale_list, &t->mlfqs_stale_elem);
+	}
+
+	if (t->recent_cpu != 0 || t->nice != 0) {
+		if (!t->mlfqs_active) {
+			t->mlfqs_active = true;
+			list_push_back (&mlfqs_list, &t->mlfqs_elem);
+		}
+	} else if (t->mlfqs_active) {
+		t->mlfqs_active = false;
+		list_remove (&t->mlfqs_elem);
+	}
+	intr_set_level (old_level);
 }
 
 void
 recalculate_load_avg (void) {
 	// recalculate load_avg according to given rule
 	// load_avg = (59/60) * load_avg + (1/60) * ready_threads
-	int ready_threads = list_size (&ready_list);
+	int ready_threads = ready_cnt;
 	if (thread_current () != idle_thread)
 		ready_threads += 1;
 	
@@ -515,6 +803,7 @@ thread_set_nice (int nice) {
 
 	struct thread *curr = thread_current ();
 	curr->nice = nice;
+	mlfqs_touch (curr);
 	thread_recalculate_priority (curr);
 	check_priority ();
 
@@ -559,6 +848,11 @@ idle (void *idle_started_ UNUSED) {
 	sema_up (idle_started);
 
 	for (;;) {
+		/* Zero free pages in advance for as long as no other
+		   thread is ready to run. */
+		while (ready_cnt == 0 && palloc_zero_idle ())
+			continue;
+
 		/* Let someone else run. */
 		intr_disable ();
 		thread_block ();
@@ -574,8 +868,14 @@ idle (void *idle_started_ UNUSED) {
 		   time.
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
-		asm volatile ("sti; hlt" : : : "memory");
+		   7.11.1 "HLT Instruction".
+
+		   In tickless mode timer_idle() does the same, after
+		   programming the timer for the next deadline. */
+		if (timer_tickless)
+			timer_idle ();
+		else
+			asm volatile ("sti; hlt" : : : "memory");
 	}
 }
 
@@ -594,14 +894,23 @@ kernel_thread (thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
 
-	memset (t, 0, sizeof *t);
+	/* Clear only the scheduler members.  The per-process members
+	   after them, mostly the file descriptor table, are set one by
+	   one below, so that a reused page is not cleared twice. */
+#ifdef USERPROG
+	memset (t, 0, offsetof (struct thread, pml4));
+#else
+	memset (t, 0, offsetof (struct thread, stack));
+#endif
 	t->status = THREAD_BLOCKED;
 	strlcpy (t->name, name, sizeof t->name);
-	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
+	t->stack = (uint8_t *) t + PGSIZE;
 	
 	if (thread_mlfqs) {
 		t->nice = NICE_DEFAULT;
@@ -612,14 +921,17 @@ init_thread (struct thread *t, const char *name, int priority) {
 		t->priority = priority;
 		t->original_priority = priority;
 		t->wait_on_lock = NULL;
-		list_init(&t->donations);
 	}
+	heap_init (&t->held_locks, lock_priority_less, NULL);
 
+	t->pml4 = NULL;
 	t->exit_status = 0;
 	t->waiting = false;
 	t->exited_by_exception = false;
 
 	list_init(&t->children);
+	t->parent = NULL;
+	t->child_failed_to_duplicate = false;
 	for (int i=0; i<3; i++)
 		sema_init(&t->sema[i], 0);
 
@@ -634,8 +946,62 @@ init_thread (struct thread *t, const char *name, int priority) {
 	}
 	t->fd_count = 0;
 	t->exec_file = NULL;
+#ifdef VM
+	memset (&t->spt, 0, sizeof t->spt);
+	t->stack_bottom = NULL;
+#endif
+#ifdef EFILESYS
+	t->dir_clst = 0;
+#endif
 
 	t->magic = THREAD_MAGIC;
+
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->all_elem);
+	intr_set_level (old_level);
+}
+
+/* Removes exiting thread T from the lists of all threads. */
+static void
+thread_forget (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_remove (&t->all_elem);
+	if (t->mlfqs_active)
+		list_remove (&t->mlfqs_elem);
+	if (t->mlfqs_stale)
+		list_remove (&t->mlfqs_stale_elem);
+}
+
+/* Appends T to the run queue of its priority.  Interrupts must
+   be off. */
+static void
+ready_queue_push (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	list_push_back (&ready_queues[t->priority], &t->elem);
+	ready_mask |= 1ULL << t->priority;
+	ready_cnt++;
+}
+
+/* Removes T from the run queue of its priority.  Interrupts must
+   be off. */
+static void
+ready_queue_remove (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_remove (&t->elem);
+	if (list_empty (&ready_queues[t->priority]))
+		ready_mask &= ~(1ULL << t->priority);
+	ready_cnt--;
+}
+
+/* Returns the highest priority among ready threads, or -1 if
+   the run queue is empty. */
+static int
+ready_queue_max_priority (void) {
+	return ready_mask != 0 ? 63 - __builtin_clzll (ready_mask) : -1;
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -645,10 +1011,15 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
+	int pri = ready_queue_max_priority ();
+	struct thread *t;
+
+	if (pri < 0)
 		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+	t = list_entry (list_front (&ready_queues[pri]), struct thread, elem);
+	ready_queue_remove (t);
+	return t;
 }
 
 /* Use iretq to launch the thread */
@@ -679,75 +1050,6 @@ do_iret (struct intr_frame *tf) {
 			: : "g" ((uint64_t) tf) : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
-
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
-
-   It's not safe to call printf() until the thread switch is
-   complete.  In practice that means that printf()s should be
-   added at the end of the function. */
-static void
-thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
-	ASSERT (intr_get_level () == INTR_OFF);
-
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
-}
-
 /* Schedules a new process. At entry, interrupts must be off.
  * This function modify current thread's status to status and then
  * finds another thread to run and switches to it.
@@ -757,9 +1059,9 @@ do_schedule(int status) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (thread_current()->status == THREAD_RUNNING);
 	while (!list_empty (&destruction_req)) {
-		struct thread *victim =
-			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		struct thread *victim = list_entry (
+				list_pop_front (&destruction_req), struct thread, elem);
+		thread_page_put (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -768,13 +1070,16 @@ do_schedule(int status) {
 static void
 schedule (void) {
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run ();
+	struct thread *next;
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
+
+	next = next_thread_to_run ();
 	ASSERT (is_thread (next));
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
+	sched_account (curr, next);
 
 	/* Start new time slice. */
 	thread_ticks = 0;
@@ -797,12 +1102,71 @@ schedule (void) {
 			list_push_back (&destruction_req, &curr->elem);
 		}
 
-		/* Before switching the thread, we first save the information
-		 * of current running. */
-		thread_launch (next);
+		/* Switch to NEXT.  We return here once we are scheduled
+		   again. */
+		switch_threads (curr, next);
 	}
 }
 
+/* Returns a page for a new thread, from the cache of dead
+   threads' pages if possible, or a null pointer if none is
+   available.  Only the members of struct thread, which
+   init_thread() sets, are guaranteed to be initialized. */
+static struct thread *
+thread_page_get (void) {
+	struct thread *t = NULL;
+	enum intr_level old_level = intr_disable ();
+
+	if (!list_empty (&thread_cache)) {
+		t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+		thread_cache_cnt--;
+		thread_pages_reused++;
+	}
+	intr_set_level (old_level);
+
+	if (t == NULL) {
+		t = palloc_get_page (PAL_ZERO);
+		if (t != NULL) {
+			old_level = intr_disable ();
+			thread_pages_allocated++;
+			intr_set_level (old_level);
+		}
+	}
+	return t;
+}
+
+/* Gives back the page of dead thread T, keeping it in the cache
+   unless the cache is full.  Clears T's magic number, so that
+   stale pointers to T fail is_thread() until the page is reused
+   and init_thread() sets it again. */
+static void
+thread_page_put (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (is_thread (t) && t->status == THREAD_DYING);
+
+	t->magic = 0;
+	if (thread_cache_cnt < THREAD_CACHE_MAX) {
+		list_push_front (&thread_cache, &t->elem);
+		thread_cache_cnt++;
+		t = NULL;
+	}
+
+	if (t != NULL)
+		palloc_free_page (t);
+}
+
+/* Allocates a SIZE-byte frame at the top of thread T's stack and
+   returns a pointer to the frame's base. */
+static void *
+alloc_frame (struct thread *t, size_t size) {
+	/* Stack data is always allocated in word-size units. */
+	ASSERT (is_thread (t));
+	ASSERT (size % sizeof (uint64_t) == 0);
+
+	t->stack -= size;
+	return t->stack;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
@@ -123,7 +123,7 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	/* 4. TODO: Duplicate parent's page to the new page and
 	 *    TODO: check whether parent's page is writable or not (set WRITABLE
 	 *    TODO: according to the result). */
-	memcpy (newpage, parent_page, PGSIZE);
+	copy_page (newpage, parent_page);
 	writable = is_writable (pte);
 
 	/* 5. Add new page to child's page table at address VA with WRITABLE
@@ -787,17 +787,27 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct necessary_info *info = malloc(sizeof (struct necessary_info));
-		info->file = file_reopen (file);
-		info->ofs = ofs;
-		info->page_read_bytes = page_read_bytes;
-		info->page_zero_bytes = page_zero_bytes;
-		// printf("Before: %p\n", info->file);
-
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, info)) {
-			return false;
+		/* A page with nothing to read is left for the page fault
+		 * handler to zero, or to map to the shared zero page. */
+		if (page_read_bytes == 0) {
+			if (!vm_alloc_page (VM_ANON, upage, writable))
+				return false;
+		} else {
+			/* TODO: Set up aux to pass information to the lazy_load_segment. */
+			struct necessary_info *info = malloc(sizeof (struct necessary_info));
+			info->file = file_reopen (file);
+			info->ofs = ofs;
+			info->page_read_bytes = page_read_bytes;
+			info->page_zero_bytes = page_zero_bytes;
+			// printf("Before: %p\n", info->file);
+
+			/* A read-only page is backed by the executable, so that
+			 * evicting it only drops it, and it is read again. */
+			if (!vm_alloc_page_with_initializer (
+						writable ? VM_ANON : VM_FILE | VM_EXEC, upage,
+						writable, lazy_load_segment, info)) {
+				return false;
+			}
 		}
 
 		/* Advance. */
@@ -8,6 +8,7 @@
 #include "threads/thread.h"
 #include "threads/loader.h"
 #include "threads/palloc.h"
+#include "threads/malloc.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
@@ -15,6 +16,8 @@
 #include "filesys/filesys.h"
 #include "filesys/directory.h"
 #include "threads/mmu.h"
+#include <schedstat.h>
+#include <string.h>
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
@@ -119,6 +122,9 @@ syscall_handler (struct intr_frame *f UNUSED) {
 			f->R.rax = inumber(f->R.rdi);
 			break;
 #endif
+		case SYS_SCHED_STATS:
+			f->R.rax = sched_stats(f->R.rdi, (struct sched_stats *) f->R.rsi);
+			break;
 		default:
 			exit(-1);
 			break;
@@ -422,6 +428,28 @@ inumber (int fd) {
 }
 #endif
 
+/* Copies the scheduler statistics of the calling thread and of
+   PRIORITY, or of the caller's priority if PRIORITY is -1, to
+   STATS.  Returns false if PRIORITY is out of range.  The
+   statistics are too big for the kernel stack, so they are
+   copied through a heap buffer. */
+bool
+sched_stats (int priority, struct sched_stats *stats) {
+	struct sched_stats *kstats;
+	bool success = false;
+
+	check_buffer (stats, sizeof *stats);
+	kstats = malloc (sizeof *kstats);
+	if (kstats == NULL)
+		return false;
+	if (thread_get_sched_stats (priority, kstats)) {
+		memcpy (stats, kstats, sizeof *kstats);
+		success = true;
+	}
+	free (kstats);
+	return success;
+}
+
 /* Check Address is valid */
 void
 check_address (void *addr) {
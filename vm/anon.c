@@ -1,7 +1,11 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include "vm/evict.h"
+#include "vm/zswap.h"
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "lib/kernel/bitmap.h"
 
@@ -21,12 +25,42 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Number of pages referring to each swap slot.  A frame shared
+ * copy-on-write by several pages is swapped out once, to one slot
+ * that all of them refer to.  The slot is freed in swap_table when
+ * the last of them lets go of it. */
+static uint16_t *slot_refs;
+
+/* Protects swap_table and slot_refs. */
+static struct lock swap_lock;
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
+	size_t slot_cnt;
+
 	swap_disk = disk_get (1, 1);
-	swap_table = bitmap_create (disk_size (swap_disk) / PAGE_SECTOR_SIZE);
+	slot_cnt = disk_size (swap_disk) / PAGE_SECTOR_SIZE;
+	swap_table = bitmap_create (slot_cnt);
+	slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+	if (swap_table == NULL || slot_refs == NULL)
+		PANIC ("vm_anon_init: out of memory");
+	lock_init (&swap_lock);
+	zswap_init (swap_disk, slot_cnt);
+}
+
+/* Drops a reference to swap slot SLOT, freeing it if it was the
+ * last one. */
+static void
+slot_put (int slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (slot_refs[slot] > 0);
+	if (--slot_refs[slot] == 0) {
+		zswap_invalidate (slot);
+		bitmap_reset (swap_table, slot);
+	}
+	lock_release (&swap_lock);
 }
 
 /* Initialize the file mapping */
@@ -39,7 +73,87 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	anon_page->sector = -1;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Makes PAGE refer to the swap slot that SRC, which is swapped
+ * out, refers to.  Used when PAGE shares SRC's contents after
+ * fork. */
+void
+anon_swap_share (struct page *page, const struct page *src) {
+	int slot = src->anon.sector;
+
+	ASSERT (slot != -1);
+	lock_acquire (&swap_lock);
+	slot_refs[slot]++;
+	lock_release (&swap_lock);
+	page->anon.sector = slot;
+}
+
+/* Returns true if PAGE can be read ahead from swap slot SLOT:
+ * it is an anonymous page, swapped out to SLOT on disk, and the
+ * only page referring to SLOT. */
+static bool
+can_read_ahead (struct page *page, int slot) {
+	bool ok;
+
+	if (page == NULL || VM_TYPE (page->operations->type) != VM_ANON
+			|| page->frame != NULL || page->anon.sector != slot
+			|| zswap_contains (slot))
+		return false;
+	lock_acquire (&swap_lock);
+	ok = slot_refs[slot] == 1;
+	lock_release (&swap_lock);
+	return ok;
+}
+
+/* Reads PAGE's contents from its swap slot on disk into KVA.
+ *
+ * Pages swapped out together went to consecutive slots in order of
+ * address, so the pages following PAGE in its process are likely
+ * in the slots following its own.  Those are read in along with
+ * PAGE, in the same transfer, into whatever frames are free, and
+ * mapped right away. */
+static void
+read_from_disk (struct page *page, void *kva) {
+	int swap_sector = page->anon.sector;
+	struct page *ra_pages[SWAP_CLUSTER];
+	struct frame *ra_frames[SWAP_CLUSTER];
+	void *bufs[SWAP_CLUSTER];
+	size_t cnt, i;
+
+	bufs[0] = kva;
+	for (cnt = 1; cnt < SWAP_CLUSTER
+			&& (size_t) swap_sector + cnt < bitmap_size (swap_table); cnt++) {
+		void *va = page->va + cnt * PGSIZE;
+		struct page *p;
+
+		if (!is_user_vaddr (va))
+			break;
+		p = spt_find_page (&page->owner->spt, va);
+		if (!can_read_ahead (p, swap_sector + cnt))
+			break;
+		ra_frames[cnt] = vm_get_free_frame ();
+		if (ra_frames[cnt] == NULL)
+			break;
+		ra_pages[cnt] = p;
+		bufs[cnt] = ra_frames[cnt]->kva;
+	}
+
+	disk_readv (swap_disk, swap_sector * PAGE_SECTOR_SIZE, bufs, cnt,
+			PAGE_SECTOR_SIZE);
+
+	for (i = 1; i < cnt; i++) {
+		struct page *p = ra_pages[i];
+
+		slot_put (p->anon.sector);
+		p->anon.sector = -1;
+		if (!vm_map_frame (p, ra_frames[i]))
+			PANIC ("anon_swap_in: out of memory");
+		evict_stats.swap_ins++;
+		evict_stats.readaheads++;
+	}
+}
+
+/* Swap in the page by read contents from the swap disk, or from
+ * the compressed cache in front of it. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
@@ -50,39 +164,92 @@ anon_swap_in (struct page *page, void *kva) {
 		return false;
 	}
 
-	for (int i=0; i<PAGE_SECTOR_SIZE; i++) {
-		disk_read (swap_disk, swap_sector * PAGE_SECTOR_SIZE + i, kva + DISK_SECTOR_SIZE * i);
-	}
+	if (!zswap_load (swap_sector, kva))
+		read_from_disk (page, kva);
 
-	bitmap_flip (swap_table, swap_sector);
+	slot_put (swap_sector);
 	pml4_set_page (thread_current ()->pml4, page->va, kva, page->writable);
 	anon_page->sector = -1;
+	evict_stats.swap_ins++;
 
 	return true; 
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Orders pages by owner, then by address. */
 static bool
-anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+page_less (const struct page *a, const struct page *b) {
+	if (a->owner != b->owner)
+		return a->owner < b->owner;
+	return a->va < b->va;
+}
 
-	int swap_sector = bitmap_scan (swap_table, 0, 1, false);
-	if (swap_sector == BITMAP_ERROR)
-		return false;
-	
-	for (int i=0; i<PAGE_SECTOR_SIZE; i++) {
-		disk_write (swap_disk, swap_sector * PAGE_SECTOR_SIZE + i, page->frame->kva + DISK_SECTOR_SIZE * i);
+/* Writes the CNT resident pages in PAGES, up to SWAP_CLUSTER of
+ * them, to CNT consecutive swap slots.  The caller has already
+ * unmapped them.  Pages that compress well go to the compressed
+ * cache, and the rest to disk, each run of consecutive slots in one
+ * transfer.  Sorts PAGES so that pages adjacent in a process go to
+ * adjacent slots, for anon_swap_in() to read ahead.  Returns false,
+ * without writing anything, if there are not CNT consecutive free
+ * slots. */
+bool
+anon_swap_out_cluster (struct page *pages[], size_t cnt) {
+	const void *bufs[SWAP_CLUSTER];
+	bool cached[SWAP_CLUSTER];
+	size_t i, j;
+	size_t slot;
+
+	ASSERT (cnt >= 1 && cnt <= SWAP_CLUSTER);
+
+	for (i = 1; i < cnt; i++) {
+		struct page *p = pages[i];
+		for (j = i; j > 0 && page_less (p, pages[j - 1]); j--)
+			pages[j] = pages[j - 1];
+		pages[j] = p;
 	}
 
-	bitmap_flip (swap_table, swap_sector);
-	pml4_clear_page(thread_current ()->pml4, page->va);
-	anon_page->sector = swap_sector;
+	lock_acquire (&swap_lock);
+	slot = bitmap_scan_and_flip_next (swap_table, cnt, false);
+	if (slot != BITMAP_ERROR)
+		for (i = 0; i < cnt; i++)
+			slot_refs[slot + i] = 1;
+	lock_release (&swap_lock);
+	if (slot == BITMAP_ERROR)
+		return false;
 
+	for (i = 0; i < cnt; i++) {
+		bufs[i] = pages[i]->frame->kva;
+		cached[i] = zswap_store (slot + i, bufs[i]);
+	}
+	for (i = 0; i < cnt; i = j) {
+		for (j = i + 1; j < cnt && cached[j] == cached[i]; j++)
+			continue;
+		if (!cached[i]) {
+			disk_writev (swap_disk, (slot + i) * PAGE_SECTOR_SIZE, bufs + i,
+					j - i, PAGE_SECTOR_SIZE);
+			evict_stats.swap_out_clusters++;
+		}
+	}
+
+	for (i = 0; i < cnt; i++) {
+		pages[i]->anon.sector = slot + i;
+		evict_stats.swap_outs++;
+	}
 	return true;
 }
 
+/* Swap out the page by writing contents to the swap disk. */
+static bool
+anon_swap_out (struct page *page) {
+	return anon_swap_out_cluster (&page, 1);
+}
+
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->sector != -1) {
+		slot_put (anon_page->sector);
+		anon_page->sector = -1;
+	}
 }
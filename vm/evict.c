@@ -0,0 +1,231 @@
+/* evict.c: Page replacement policies. */
+
+#include "vm/evict.h"
+#include <inttypes.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* Three policies are available, chosen with the kernel command
+ * line option -evict=POLICY.
+ *
+ * "fifo" evicts the frame that has been in use the longest.
+ *
+ * "clock" (the default) sweeps a hand over the frame table,
+ * giving each frame whose accessed bit is set a second chance,
+ * and clearing the bit.  It prefers frames that are also clean,
+ * since they need not be written out: it first looks for a frame
+ * that is neither accessed nor dirty, then for one that is not
+ * accessed, clearing accessed bits as it goes, and so on.
+ *
+ * "lru" approximates least-recently-used by aging.  On each
+ * eviction, each frame's 8-bit age is shifted right and its
+ * accessed bit is shifted in at the top, then cleared.  The frame
+ * with the lowest age, and clean if there is a tie, is evicted.
+ *
+ * The accessed and dirty bits are those of the user mappings of
+ * the frame in its owners' page tables; a frame shared after fork
+ * counts as accessed or dirty if any of its mappings is.  The
+ * kernel's own alias of the frame is ignored, since the kernel
+ * writes to it only to fill the frame in from disk. */
+
+static struct frame *fifo_victim (void);
+static void clock_remove (struct frame *);
+static struct frame *clock_victim (void);
+static void lru_insert (struct frame *);
+static struct frame *lru_victim (void);
+
+static const struct evict_policy fifo_policy = {
+	.name = "fifo",
+	.victim = fifo_victim,
+};
+
+static const struct evict_policy clock_policy = {
+	.name = "clock",
+	.remove = clock_remove,
+	.victim = clock_victim,
+};
+
+static const struct evict_policy lru_policy = {
+	.name = "lru",
+	.insert = lru_insert,
+	.victim = lru_victim,
+};
+
+static const struct evict_policy *policies[] = {
+	&fifo_policy, &clock_policy, &lru_policy,
+};
+
+/* Policy in use. */
+const struct evict_policy *evict_policy = &clock_policy;
+
+struct evict_stats evict_stats;
+
+/* Selects the policy named NAME.  Returns false if there is no
+ * such policy. */
+bool
+evict_set_policy (const char *name) {
+	size_t i;
+
+	for (i = 0; i < sizeof policies / sizeof *policies; i++)
+		if (!strcmp (name, policies[i]->name)) {
+			evict_policy = policies[i];
+			return true;
+		}
+	return false;
+}
+
+/* Returns true if any page mapping FRAME was accessed since its
+ * accessed bit was last cleared. */
+bool
+frame_is_accessed (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, rmap_elem);
+		uint64_t *pml4 = page->owner->pml4;
+
+		if (pml4 != NULL && pml4_is_accessed (pml4, page->va))
+			return true;
+	}
+	return false;
+}
+
+/* Returns true if any page mapping FRAME was written to since it
+ * was mapped. */
+bool
+frame_is_dirty (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, rmap_elem);
+		uint64_t *pml4 = page->owner->pml4;
+
+		if (pml4 != NULL && pml4_is_dirty (pml4, page->va))
+			return true;
+	}
+	return false;
+}
+
+/* Clears the accessed bits of all the pages mapping FRAME. */
+static void
+frame_clear_accessed (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, rmap_elem);
+
+		if (page->owner->pml4 != NULL)
+			pml4_set_accessed (page->owner->pml4, page->va, false);
+	}
+}
+
+/* Prints eviction and swap statistics. */
+void
+evict_print_stats (void) {
+	printf ("Evict: %s policy, %"PRIu64" evictions (%"PRIu64" clean), "
+			"%"PRIu64" swap outs in %"PRIu64" transfers, "
+			"%"PRIu64" swap ins (%"PRIu64" read ahead), "
+			"%"PRIu64" file writes\n",
+			evict_policy->name, evict_stats.evictions,
+			evict_stats.clean_evictions, evict_stats.swap_outs,
+			evict_stats.swap_out_clusters, evict_stats.swap_ins,
+			evict_stats.readaheads, evict_stats.file_writes);
+}
+
+/* FIFO. */
+
+static struct frame *
+fifo_victim (void) {
+	return list_entry (list_front (&frame_list), struct frame, frame_elem);
+}
+
+/* Clock. */
+
+/* Frame the clock hand points to, or null to start at the front
+ * of frame_list. */
+static struct frame *clock_hand;
+
+/* Returns the frame under the clock hand and advances the hand,
+ * wrapping around at the end of frame_list. */
+static struct frame *
+clock_advance (void) {
+	struct frame *frame = clock_hand;
+	struct list_elem *next;
+
+	if (frame == NULL)
+		frame = list_entry (list_front (&frame_list), struct frame, frame_elem);
+	next = list_next (&frame->frame_elem);
+	clock_hand = (next != list_end (&frame_list)
+			? list_entry (next, struct frame, frame_elem) : NULL);
+	return frame;
+}
+
+static void
+clock_remove (struct frame *frame) {
+	if (clock_hand == frame)
+		clock_advance ();
+}
+
+static struct frame *
+clock_victim (void) {
+	size_t frame_cnt = list_size (&frame_list);
+	int pass;
+	size_t i;
+
+	/* Passes 0 and 2 look for a frame neither accessed nor dirty.
+	 * Passes 1 and 3 take any frame not accessed, and clear the
+	 * accessed bits of the others, so pass 3 always succeeds. */
+	for (pass = 0; pass < 4; pass++)
+		for (i = 0; i < frame_cnt; i++) {
+			struct frame *frame = clock_advance ();
+
+			if (frame_is_accessed (frame)) {
+				if (pass % 2 == 1)
+					frame_clear_accessed (frame);
+			} else if (pass % 2 == 1 || !frame_is_dirty (frame))
+				return frame;
+		}
+	NOT_REACHED ();
+}
+
+/* LRU approximation by aging. */
+
+static void
+lru_insert (struct frame *frame) {
+	/* Count as just used. */
+	frame->age = 0x80;
+}
+
+static struct frame *
+lru_victim (void) {
+	struct frame *victim = NULL;
+	bool victim_dirty = false;
+	struct list_elem *e;
+
+	for (e = list_begin (&frame_list); e != list_end (&frame_list);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, frame_elem);
+		bool dirty;
+
+		frame->age >>= 1;
+		if (frame_is_accessed (frame)) {
+			frame->age |= 0x80;
+			frame_clear_accessed (frame);
+		}
+
+		dirty = frame_is_dirty (frame);
+		if (victim == NULL || frame->age < victim->age
+				|| (frame->age == victim->age && victim_dirty && !dirty)) {
+			victim = frame;
+			victim_dirty = dirty;
+		}
+	}
+	return victim;
+}
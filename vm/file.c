@@ -1,6 +1,8 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "vm/evict.h"
+#include "threads/mmu.h"
 #include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -27,6 +29,8 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->exec = (type & VM_EXEC) != 0;
+	return true;
 }
 
 /* Swap in the page by read contents from the file. */
@@ -51,10 +55,17 @@ file_backed_swap_in (struct page *page, void *kva) {
 	return true;
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  The
+ * evictor calls this only for a dirty page, after unmapping it: a
+ * clean one can be read back from the file as it is. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	/* An executable is not written to while it runs, and its
+	 * read-only pages cannot be dirty. */
+	if (file_page->exec)
+		return true;
 
 	struct necessary_info *info = (struct necessary_info *)page->uninit.aux;
 	
@@ -64,13 +75,12 @@ file_backed_swap_out (struct page *page) {
 	size_t page_read_bytes = info->page_read_bytes;
 	size_t page_zero_bytes = info->page_zero_bytes;
 
-	file_seek (file, ofs);
-	if (file_write (file, page->frame->kva, page_read_bytes) != page_read_bytes) {
+	if (file_write_at (file, page->frame->kva, page_read_bytes, ofs)
+			!= page_read_bytes) {
 		ASSERT(0);
 		return false;
 	}
-
-    pml4_clear_page(thread_current ()->pml4, page->va);
+	evict_stats.file_writes++;
 	return true;
 }
 
@@ -1,12 +1,52 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
+#include "threads/synch.h"
 #include "vm/vm.h"
+#include "vm/evict.h"
 #include "vm/inspect.h"
+#include "filesys/inode.h"
 #include "userprog/syscall.h"
 
+/* Caches for struct page and struct frame. */
+static struct slab_cache *page_slab;
+static struct slab_cache *frame_slab;
+
+/* Protects frame_list. */
+static struct lock frame_lock;
+
+/* Signaled, with frame_lock held, when vm_evict_frame() is done with
+ * the frames it was writing out.  evict_cnt counts those frames. */
+static struct condition evict_done;
+static size_t evict_cnt;
+
+/* Frames holding read-only pages of executables, by where in the
+ * file they were read from, so that every process running the same
+ * program maps the same frames.  Protected by frame_lock. */
+static struct hash share_index;
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+
+/* Fault-around window bounds, in pages.  See vm_claim_file_pages(). */
+#define FAULT_AROUND_MIN 4
+#define FAULT_AROUND_MAX 16
+
+/* Statistics. */
+static uint64_t file_fault_cnt;     /* Faults on pages read from files. */
+static uint64_t fault_around_cnt;   /* Pages brought in around them. */
+static uint64_t share_hit_cnt;      /* Pages mapped from share_index. */
+static size_t share_frame_cnt;      /* Frames now on share_index. */
+
+/* The shared zero page.  Anonymous pages that start out zeroed are
+ * mapped to it read-only until they are first written. */
+static void *zero_kva;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -20,6 +60,14 @@ vm_init (void) {
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	list_init (&frame_list);
+	lock_init (&frame_lock);
+	cond_init (&evict_done);
+	page_slab = slab_cache_create ("page", sizeof (struct page), NULL);
+	frame_slab = slab_cache_create ("frame", sizeof (struct frame), NULL);
+	if (page_slab == NULL || frame_slab == NULL
+			|| !hash_init (&share_index, share_hash, share_less, NULL))
+		PANIC ("vm_init: out of memory");
+	zero_kva = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -39,6 +87,8 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_claim_page_in (struct page *page, struct frame *frame);
+static bool page_is_zero_fill (struct page *page);
 static struct frame *vm_evict_frame (void);
 
 /* Create the pending page object with initializer. If you want to create a
@@ -57,7 +107,9 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		/* TODO: Create the page, fetch the initialier according to the VM type,
 		 * TODO: and then create "uninit" page struct by calling uninit_new. You
 		 * TODO: should modify the field after calling the uninit_new. */
-		struct page *page = malloc(sizeof (struct page));
+		struct page *page = slab_alloc (page_slab);
+		if (page == NULL)
+			goto err;
 		switch (VM_TYPE(type)) {
 			case VM_ANON:
 				uninit_new (page, upage, init, type, aux, anon_initializer);
@@ -67,6 +119,7 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 				break;
 		}
 		page->writable = writable;
+		page->owner = thread_current ();
 		/* TODO: Insert the page into the spt. */
 		spt_insert_page (spt, page);
 		return true;
@@ -79,11 +132,10 @@ err:
 struct page *
 spt_find_page (struct supplemental_page_table *spt, void *va) {
 	/* TODO: Fill this function. */
-	struct page *fake_page = malloc(sizeof (struct page));
-	fake_page->va = pg_round_down (va);
+	struct page key;
+	key.va = pg_round_down (va);
 
-	struct hash_elem *e = hash_find (&spt->hash_for_spt, &fake_page->hash_elem);
-	free(fake_page);
+	struct hash_elem *e = hash_find (&spt->hash_for_spt, &key.hash_elem);
 
 	if (e != NULL)
 		return hash_entry (e, struct page, hash_elem);
@@ -107,47 +159,301 @@ spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
 	return true;
 }
 
+/* Adds FRAME to the back of frame_list.
+ * The caller must hold frame_lock. */
+static void
+frame_list_insert (struct frame *frame) {
+	list_push_back (&frame_list, &frame->frame_elem);
+	if (evict_policy->insert != NULL)
+		evict_policy->insert (frame);
+}
+
+/* Removes FRAME from frame_list.
+ * The caller must hold frame_lock. */
+static void
+frame_list_remove (struct frame *frame) {
+	if (evict_policy->remove != NULL)
+		evict_policy->remove (frame);
+	list_remove (&frame->frame_elem);
+}
+
+/* Adds PAGE to the pages mapping FRAME. */
+static void
+frame_map (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->rmap_elem);
+	frame->ref_cnt++;
+	if (frame->page == NULL)
+		frame->page = page;
+	page->frame = frame;
+}
+
+/* Removes PAGE from the pages mapping FRAME. */
+static void
+frame_unmap (struct frame *frame, struct page *page) {
+	ASSERT (page->frame == frame);
+
+	list_remove (&page->rmap_elem);
+	frame->ref_cnt--;
+	if (frame->page == page)
+		frame->page = (frame->ref_cnt > 0
+				? list_entry (list_front (&frame->pages), struct page, rmap_elem)
+				: NULL);
+	page->frame = NULL;
+
+	/* Nothing maps the contents any more. */
+	if (frame->ref_cnt == 0 && frame->inode != NULL) {
+		hash_delete (&share_index, &frame->share_elem);
+		frame->inode = NULL;
+		share_frame_cnt--;
+	}
+}
+
+/* Makes FRAME a candidate for eviction. */
+static void
+frame_list_add (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	frame_list_insert (frame);
+	lock_release (&frame_lock);
+}
+
+/* Returns a new frame for the memory at KVA, or a null pointer if
+ * memory is exhausted. */
+static struct frame *
+frame_new (void *kva) {
+	struct frame *frame = slab_alloc (frame_slab);
+
+	if (frame != NULL) {
+		frame->kva = kva;
+		frame->page = NULL;
+		list_init (&frame->pages);
+		frame->ref_cnt = 0;
+		frame->evicting = false;
+		frame->inode = NULL;
+	}
+	return frame;
+}
+
+/* Frees FRAME, which must not be on frame_list, and its memory. */
+static void
+frame_free (struct frame *frame) {
+	ASSERT (frame->ref_cnt == 0);
+
+	palloc_free_page (frame->kva);
+	slab_free (frame_slab, frame);
+}
+
 /* Get the struct frame, that will be evicted. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	ASSERT (!list_empty (&frame_list));
 
-	struct list_elem *e = list_front (&frame_list); // FIFO Policy
-	victim = list_entry (e, struct frame, frame_elem);
+	return evict_policy->victim ();
+}
+
+/* Unmaps all the pages sharing VICTIM, whose contents PAGE, one
+ * of them, has just been swapped out, and has them refer to the
+ * swapped-out contents. */
+static void
+frame_unmap_all (struct frame *victim, struct page *page) {
+	while (victim->ref_cnt > 0) {
+		struct page *p = list_entry (list_front (&victim->pages),
+				struct page, rmap_elem);
+
+		if (p != page) {
+			if (VM_TYPE (p->operations->type) == VM_ANON)
+				anon_swap_share (p, page);
+			if (p->owner->pml4 != NULL)
+				pml4_clear_page (p->owner->pml4, p->va);
+		}
+		frame_unmap (victim, p);
+	}
+}
+
+/* Clears the page table entries of all the pages mapping FRAME,
+ * so that they fault instead of using it. */
+static void
+frame_clear_ptes (struct frame *frame) {
+	struct list_elem *e;
 
-	return victim;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, rmap_elem);
+
+		if (p->owner->pml4 != NULL)
+			pml4_clear_page (p->owner->pml4, p->va);
+	}
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+/* Maps all the pages mapping FRAME to it again, after
+ * frame_clear_ptes(), marking them dirty if DIRTY is true.  A
+ * frame shared copy-on-write stays read-only. */
+static void
+frame_restore_ptes (struct frame *frame, bool dirty) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, rmap_elem);
+		uint64_t *pml4 = p->owner->pml4;
+
+		if (pml4 == NULL)
+			continue;
+		/* The page tables are still there, so this cannot fail. */
+		pml4_set_page (pml4, p->va, frame->kva,
+				p->writable && frame->ref_cnt == 1);
+		if (dirty)
+			pml4_set_dirty (pml4, p->va, true);
+	}
+}
+
+/* Waits until PAGE's frame, if it has one, is not being evicted.
+ * The caller must hold frame_lock. */
+static void
+frame_wait_evicted (struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	while (page->frame != NULL && page->frame->evicting)
+		cond_wait (&evict_done, &frame_lock);
+}
+
+/* Evict one page and return the corresponding frame, which is
+ * no longer on frame_list.  Return NULL on error.
+ *
+ * Evicts up to SWAP_CLUSTER frames in one go, freeing all but the
+ * one returned, so that the faults that follow find free frames.
+ * The anonymous pages among them are written to swap together, in
+ * one transfer to consecutive slots.
+ *
+ * The caller must hold frame_lock.  It is released while the
+ * victims are written out, so that other processes can fault and
+ * allocate frames meanwhile.  The victims are unmapped and marked
+ * as being evicted first: anything that would use them waits on
+ * evict_done until they are gone, or back on frame_list if writing
+ * them out failed. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
-	swap_out (victim->page);
-	return victim;
+	struct frame *victims[SWAP_CLUSTER];
+	struct page *anon_pages[SWAP_CLUSTER];
+	bool dirty[SWAP_CLUSTER], written[SWAP_CLUSTER];
+	size_t victim_cnt = 0, anon_cnt = 0;
+	struct frame *result = NULL;
+	bool anon_done;
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	/* Take the victims away from their pages... */
+	while (victim_cnt < SWAP_CLUSTER && !list_empty (&frame_list)) {
+		struct frame *victim = vm_get_victim ();
+
+		frame_list_remove (victim);
+		evict_stats.evictions++;
+		dirty[victim_cnt] = frame_is_dirty (victim);
+		if (!dirty[victim_cnt])
+			evict_stats.clean_evictions++;
+		frame_clear_ptes (victim);
+		victim->evicting = true;
+		evict_cnt++;
+		victims[victim_cnt++] = victim;
+		if (VM_TYPE (victim->page->operations->type) == VM_ANON)
+			anon_pages[anon_cnt++] = victim->page;
+	}
+
+	/* ...write them out without holding the lock... */
+	lock_release (&frame_lock);
+	anon_done = anon_cnt > 0 && anon_swap_out_cluster (anon_pages, anon_cnt);
+	for (i = 0; i < victim_cnt; i++) {
+		struct page *page = victims[i]->page;
+
+		if (VM_TYPE (page->operations->type) == VM_ANON)
+			written[i] = anon_done || swap_out (page);
+		else
+			/* A clean page can be read back from its file. */
+			written[i] = !dirty[i] || swap_out (page);
+	}
+	lock_acquire (&frame_lock);
+
+	/* ...and let go of them. */
+	for (i = 0; i < victim_cnt; i++) {
+		struct frame *victim = victims[i];
+
+		victim->evicting = false;
+		evict_cnt--;
+		if (!written[i]) {
+			frame_restore_ptes (victim, dirty[i]);
+			frame_list_insert (victim);
+			continue;
+		}
+		frame_unmap_all (victim, victim->page);
+		if (result == NULL)
+			result = victim;
+		else
+			frame_free (victim);
+	}
+	cond_broadcast (&evict_done, &frame_lock);
+	return result;
+}
+
+/* Returns a free frame without evicting anything, or a null
+ * pointer if there is none.  As for vm_get_frame(), the frame must
+ * be filled in and then passed to vm_map_frame(). */
+struct frame *
+vm_get_free_frame (void) {
+	struct frame *frame;
+	void *kva = palloc_get_page (PAL_USER);
+
+	if (kva == NULL)
+		return NULL;
+	frame = frame_new (kva);
+	if (frame == NULL)
+		palloc_free_page (kva);
+	return frame;
+}
+
+/* Maps PAGE, in its owner's page table, to FRAME, which holds its
+ * contents, and makes FRAME a candidate for eviction.  Returns
+ * false, and frees FRAME, if the page table could not be extended. */
+bool
+vm_map_frame (struct page *page, struct frame *frame) {
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable)) {
+		frame_free (frame);
+		return false;
+	}
+	frame_map (frame, page);
+	frame_list_add (frame);
+	return true;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.
+ *
+ * The frame is not on frame_list, so it cannot be evicted until
+ * the caller has filled it in and added it with frame_list_add().
+ * If ZERO is true, the frame is zeroed. */
 static struct frame *
-vm_get_frame (void) {
-	/* TODO: Fill this function. */
-	void *kva = palloc_get_page (PAL_USER);
+vm_get_frame (bool zero) {
+	struct frame *frame;
+	void *kva = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+
 	if (kva == NULL) {
-		struct frame *frame = vm_evict_frame ();
-		frame->page = NULL;
-		return frame;
+		lock_acquire (&frame_lock);
+		/* Every other frame may be on its way out already. */
+		while ((frame = vm_evict_frame ()) == NULL && evict_cnt > 0)
+			cond_wait (&evict_done, &frame_lock);
+		lock_release (&frame_lock);
+		if (frame == NULL)
+			PANIC ("vm_get_frame: out of memory and swap");
+		if (zero)
+			clear_page (frame->kva);
+	} else {
+		frame = frame_new (kva);
+		if (frame == NULL)
+			PANIC ("vm_get_frame: out of memory");
 	}
-
-	struct frame *frame = malloc(sizeof (struct frame));
-	frame->kva = kva;
-	frame->page = NULL;
-
-	list_push_back (&frame_list, &frame->frame_elem);
 	return frame;
 }
 
@@ -156,15 +462,307 @@ static void
 vm_stack_growth () {
 	void *new_stack_bottom = thread_current ()->stack_bottom - PGSIZE;
 
-	if (vm_alloc_page (VM_ANON, new_stack_bottom, true)) {
-		vm_claim_page (new_stack_bottom);
+	if (vm_alloc_page (VM_ANON, new_stack_bottom, true))
 		thread_current ()->stack_bottom = new_stack_bottom;
+}
+
+/* Returns true if PAGE has not been brought in yet and starts out
+ * zeroed. */
+static bool
+page_is_zero_fill (struct page *page) {
+	return (page->operations->type == VM_UNINIT
+			&& VM_TYPE (page->uninit.type) == VM_ANON
+			&& page->uninit.init == NULL);
+}
+
+/* Returns the file information of PAGE if it has not been brought
+ * in yet and is to be read from a file, or a null pointer.  (All
+ * the initializers in use take a struct necessary_info.) */
+static struct necessary_info *
+page_file_info (struct page *page) {
+	if (page->operations->type != VM_UNINIT || page->uninit.init == NULL)
+		return NULL;
+	return page->uninit.aux;
+}
+
+/* Returns a hash of FRAME's place in share_index. */
+static uint64_t
+share_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *frame = hash_entry (e, struct frame, share_elem);
+
+	return hash_bytes (&frame->inode, sizeof frame->inode)
+		^ hash_int (frame->ofs) ^ hash_int (frame->read_bytes);
+}
+
+/* Orders frames on share_index by inode, offset and bytes read. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct frame *a = hash_entry (a_, struct frame, share_elem);
+	const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
+
+/* Returns the file information of PAGE if it is not in memory and
+ * may share its frame through share_index, or a null pointer.  That
+ * is a read-only page of an executable (VM_EXEC), which cannot be
+ * written to while it runs, whether it has been brought in before
+ * or not. */
+static struct necessary_info *
+page_share_info (struct page *page) {
+	struct necessary_info *info = page_file_info (page);
+
+	if (info != NULL)
+		return page->uninit.type & VM_EXEC ? info : NULL;
+	if (page->operations->type == VM_FILE && page->file.exec
+			&& page->frame == NULL)
+		return page->uninit.aux;
+	return NULL;
+}
+
+/* Maps PAGE, which page_share_info() accepts, to a frame on
+ * share_index that already holds its contents.  Returns false if
+ * there is none. */
+static bool
+vm_share_map (struct page *page, const struct necessary_info *info) {
+	struct frame key, *frame = NULL;
+	struct hash_elem *e;
+
+	key.inode = file_get_inode (info->file);
+	key.ofs = info->ofs;
+	key.read_bytes = info->page_read_bytes;
+
+	lock_acquire (&frame_lock);
+	e = hash_find (&share_index, &key.share_elem);
+	if (e != NULL) {
+		frame = hash_entry (e, struct frame, share_elem);
+		if (!frame->evicting
+				&& pml4_set_page (page->owner->pml4, page->va, frame->kva, false)) {
+			/* The contents are there, so only transmute PAGE, if it
+			 * has not been brought in before. */
+			if (page->operations->type == VM_UNINIT)
+				page->uninit.page_initializer (page, page->uninit.type,
+						frame->kva);
+			frame_map (frame, page);
+			share_hit_cnt++;
+		} else
+			frame = NULL;
 	}
+	lock_release (&frame_lock);
+	return frame != NULL;
 }
 
-/* Handle the fault on write_protected page */
+/* Puts the frame PAGE has just been read into with INFO, which
+ * page_share_info() accepted, on share_index, unless it has been
+ * evicted again or another process got there first. */
+static void
+vm_share_publish (struct page *page, const struct necessary_info *info) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	if (frame != NULL && !frame->evicting && frame->inode == NULL
+			&& frame->ref_cnt == 1) {
+		frame->inode = file_get_inode (info->file);
+		frame->ofs = info->ofs;
+		frame->read_bytes = info->page_read_bytes;
+		if (hash_insert (&share_index, &frame->share_elem) == NULL)
+			share_frame_cnt++;
+		else
+			frame->inode = NULL;
+	}
+	lock_release (&frame_lock);
+}
+
+/* Brings in PAGE, which is to be read from a file as INFO says,
+ * together with the pages following it that are to be read by the
+ * same initializer from the bytes that follow in the same file, so
+ * that accessing them does not fault.  The pages not found on
+ * share_index are read with a single inode_read_pages().  Stops at
+ * the first page that does not qualify, or when there are no free
+ * frames: fault-around never evicts.
+ *
+ * The number of pages brought in, counting PAGE, adapts to the
+ * access pattern.  A fault right after the pages brought in around
+ * the last one doubles it, up to FAULT_AROUND_MAX, and any other
+ * fault drops it back to FAULT_AROUND_MIN. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_claim_file_pages (struct supplemental_page_table *spt, struct page *page,
+		struct necessary_info *info) {
+	struct page *pages[FAULT_AROUND_MAX];
+	void *kvas[FAULT_AROUND_MAX];
+	vm_initializer *init = page->uninit.init;
+	struct inode *inode = file_get_inode (info->file);
+	off_t read_ofs = 0, read_bytes = 0;
+	bool success = true;
+	size_t cnt = 0, i;
+
+	if (page->va == spt->fault_next && spt->fault_window < FAULT_AROUND_MAX)
+		spt->fault_window *= 2;
+	else if (page->va != spt->fault_next)
+		spt->fault_window = FAULT_AROUND_MIN;
+
+	/* Gather the pages to read, which must be contiguous in the
+	 * file.  A page found on share_index is mapped on the spot, and
+	 * ends the run if there is one. */
+	for (i = 0; i < spt->fault_window; i++) {
+		void *va = page->va + i * PGSIZE;
+		struct page *p = page;
+		struct necessary_info *p_info = info;
+		struct frame *frame;
+
+		if (i > 0) {
+			p = is_user_vaddr (va) ? spt_find_page (spt, va) : NULL;
+			p_info = p != NULL ? page_file_info (p) : NULL;
+			if (p_info == NULL || p->uninit.init != init
+					|| file_get_inode (p_info->file) != inode
+					|| p_info->ofs != info->ofs + (off_t) (i * PGSIZE))
+				break;
+		}
+		if (page_share_info (p) != NULL && vm_share_map (p, p_info)) {
+			if (i > 0)
+				fault_around_cnt++;
+			if (cnt > 0) {
+				i++;
+				break;
+			}
+			continue;
+		}
+
+		/* The page before must be read in full, or the read would
+		 * put file data in its zeroed tail. */
+		if (cnt > 0 && read_bytes != (off_t) (cnt * PGSIZE))
+			break;
+		frame = i == 0 ? vm_get_frame (false) : vm_get_free_frame ();
+		if (frame == NULL)
+			break;
+		if (cnt == 0)
+			read_ofs = p_info->ofs;
+		frame_map (frame, p);
+		pages[cnt] = p;
+		kvas[cnt++] = frame->kva;
+		read_bytes = (cnt - 1) * PGSIZE + p_info->page_read_bytes;
+	}
+	spt->fault_next = page->va + i * PGSIZE;
+
+	if (cnt == 0)
+		return true;
+
+	/* Read them... */
+	if (inode_read_pages (inode, kvas, cnt, read_bytes, read_ofs) != read_bytes) {
+		for (i = 0; i < cnt; i++) {
+			struct frame *frame = pages[i]->frame;
+
+			frame_unmap (frame, pages[i]);
+			frame_free (frame);
+		}
+		return pages[0] != page;
+	}
+
+	/* ...and map them.  The contents are there, so only transmute
+	 * them. */
+	for (i = 0; i < cnt; i++) {
+		struct page *p = pages[i];
+		struct necessary_info *p_info = page_file_info (p);
+		bool share = page_share_info (p) != NULL;
+		struct frame *frame = p->frame;
+
+		memset (kvas[i] + p_info->page_read_bytes, 0,
+				PGSIZE - p_info->page_read_bytes);
+		if (!pml4_set_page (p->owner->pml4, p->va, kvas[i], p->writable)) {
+			frame_unmap (frame, p);
+			frame_free (frame);
+			if (p == page)
+				success = false;
+			continue;
+		}
+		p->uninit.page_initializer (p, p->uninit.type, kvas[i]);
+		frame_list_add (frame);
+		if (share)
+			vm_share_publish (p, p_info);
+		if (p != page)
+			fault_around_cnt++;
+	}
+	return success;
+}
+
+/* Waits for an eviction of PAGE's frame in progress, if any, to
+ * end.  Returns true if there was one and PAGE is still in the
+ * frame, because writing it out failed. */
+static bool
+vm_wait_evicted (struct page *page) {
+	bool waited, resident;
+
+	lock_acquire (&frame_lock);
+	waited = page->frame != NULL && page->frame->evicting;
+	frame_wait_evicted (page);
+	resident = waited && page->frame != NULL;
+	lock_release (&frame_lock);
+	return resident;
+}
+
+/* Maps PAGE, which must be zero-fill, to the shared zero page.
+ * The first write to it faults, and gets it a frame of its own. */
+static bool
+vm_map_zero_page (struct page *page) {
+	if (!pml4_set_page (page->owner->pml4, page->va, zero_kva, false))
+		return false;
+	page->zero_mapped = true;
+	return true;
+}
+
+/* Handle the fault on write_protected page.
+ * PAGE is writable but mapped read-only because it shares its frame
+ * copy-on-write.  Gives PAGE a copy of the frame of its own, or, if
+ * the other sharers have gone away, takes over the frame. */
+static bool
+vm_handle_wp (struct page *page) {
+	uint64_t *pml4 = page->owner->pml4;
+	struct frame *old, *new;
+
+	lock_acquire (&frame_lock);
+	frame_wait_evicted (page);
+	old = page->frame;
+	if (old == NULL || old->ref_cnt == 1) {
+		/* Evicted: retrying will fault the page back in. */
+		if (old != NULL)
+			pml4_set_writable (pml4, page->va, true);
+		lock_release (&frame_lock);
+		return true;
+	}
+	lock_release (&frame_lock);
+
+	/* Evicting for the copy may take the shared frame away, or
+	 * leave PAGE as its only user, so check again afterward. */
+	new = vm_get_frame (false);
+
+	lock_acquire (&frame_lock);
+	frame_wait_evicted (page);
+	old = page->frame;
+	if (old == NULL || old->ref_cnt == 1) {
+		/* Swapped out: retrying will fault the page back in.
+		 * Otherwise PAGE now has the frame to itself. */
+		if (old != NULL)
+			pml4_set_writable (pml4, page->va, true);
+		lock_release (&frame_lock);
+		frame_free (new);
+		return true;
+	}
+
+	copy_page (new->kva, old->kva);
+	frame_unmap (old, page);
+	frame_map (new, page);
+	/* The PTE exists, so this cannot fail. */
+	pml4_clear_page (pml4, page->va);
+	pml4_set_page (pml4, page->va, new->kva, true);
+	frame_list_insert (new);
+	lock_release (&frame_lock);
+	return true;
 }
 
 /* Return true on success */
@@ -174,28 +772,65 @@ vm_try_handle_fault (struct intr_frame *f, void *addr, bool user, bool write, bo
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 	if (not_present) {
-		if (!vm_claim_page (addr)) {
+		struct page *page = spt_find_page (spt, addr);
+		if (page == NULL) {
 			if (f->rsp - 8 <= addr && USER_STACK - 0x100000 <= addr && addr <= USER_STACK) {
-                vm_stack_growth ();
-                return true;
-            }
+				vm_stack_growth ();
+				/* If ADDR is further down, retry to grow again. */
+				page = spt_find_page (spt, addr);
+				if (page == NULL)
+					return true;
+			}
 			else {
 				return false;
 			}
 		}
-		else {
+		/* PAGE may have been unmapped to be evicted.  If evicting it
+		 * failed, it is back. */
+		if (vm_wait_evicted (page))
 			return true;
+
+		/* Reading a page that starts out zeroed needs no frame. */
+		if (!write && page_is_zero_fill (page))
+			return vm_map_zero_page (page);
+
+		struct necessary_info *info = page_file_info (page);
+		if (info == NULL) {
+			/* An evicted page of an executable may be in memory
+			 * for another process. */
+			info = page_share_info (page);
+			if (info == NULL)
+				return vm_do_claim_page (page);
+			if (vm_share_map (page, info))
+				return true;
+			if (!vm_do_claim_page (page))
+				return false;
+			vm_share_publish (page, info);
+			return true;
+		}
+
+		file_fault_cnt++;
+		return vm_claim_file_pages (spt, page, info);
+	}
+	else if (write) {
+		struct page *page = spt_find_page (spt, addr);
+		if (page == NULL || !page->writable)
+			return false;
+		if (page->zero_mapped) {
+			pml4_clear_page (page->owner->pml4, page->va);
+			page->zero_mapped = false;
+			return vm_do_claim_page (page);
 		}
+		return vm_handle_wp (page);
 	}
 	return false;
 }
 
-/* Free the page.
- * DO NOT MODIFY THIS FUNCTION. */
+/* Free the page. */
 void
 vm_dealloc_page (struct page *page) {
 	destroy (page);
-	free (page);
+	slab_free (page_slab, page);
 }
 
 /* Claim the page that allocate on VA. */
@@ -213,24 +848,43 @@ vm_claim_page (void *va) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	return vm_claim_page_in (page, vm_get_frame (page_is_zero_fill (page)));
+}
+
+/* Claim the PAGE into FRAME, which is not on frame_list yet, and set
+ * up the mmu. */
+static bool
+vm_claim_page_in (struct page *page, struct frame *frame) {
+	uint64_t *pml4 = page->owner->pml4;
 
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	frame_map (frame, page);
 
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-	struct thread *curr = thread_current ();
-	if (!pml4_set_page (curr->pml4, page->va, frame->kva, page->writable))
-		return false;
+	if (!pml4_set_page (pml4, page->va, frame->kva, page->writable))
+		goto fail;
+	if (!swap_in (page, frame->kva)) {
+		pml4_clear_page (pml4, page->va);
+		goto fail;
+	}
 
-	return swap_in (page, frame->kva);
+	frame_list_add (frame);
+	return true;
+
+fail:
+	/* FRAME is on neither frame_list nor share_index, so nothing else
+	 * can have found it. */
+	frame_unmap (frame, page);
+	frame_free (frame);
+	return false;
 }
 
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt) {
 	hash_init (&spt->hash_for_spt, hash_hash_func_for_spt, hash_less_func_for_spt, NULL);
+	spt->fault_next = NULL;
+	spt->fault_window = FAULT_AROUND_MIN;
 }
 
 uint64_t 
@@ -247,7 +901,51 @@ hash_less_func_for_spt (const struct hash_elem *a, const struct hash_elem *b, vo
 		return false;
 }
 
-/* Copy supplemental page table from src to dst */
+/* Makes CHILD, a copy of PARENT in the current process, share
+ * PARENT's contents copy-on-write: a resident page's frame becomes
+ * shared and read-only in both processes until one of them writes to
+ * it, and a swapped-out page's swap slot gains a reference. */
+static bool
+spt_share_page (struct page *child, struct page *parent) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct frame *frame;
+	bool success = true;
+
+	lock_acquire (&frame_lock);
+	frame_wait_evicted (parent);
+	frame = parent->frame;
+	if (frame != NULL) {
+		if (pml4_set_page (pml4, child->va, frame->kva, false)) {
+			pml4_set_writable (parent->owner->pml4, parent->va, false);
+			if (pml4_is_dirty (parent->owner->pml4, parent->va))
+				pml4_set_dirty (pml4, child->va, true);
+			frame_map (frame, child);
+		} else
+			success = false;
+	} else if (VM_TYPE (parent->operations->type) == VM_ANON
+			&& parent->anon.sector != -1)
+		anon_swap_share (child, parent);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Returns a copy of INFO, with its own file, or a null pointer if
+ * INFO is null or memory is exhausted. */
+static struct necessary_info *
+necessary_info_copy (const struct necessary_info *info) {
+	struct necessary_info *copy;
+
+	if (info == NULL || (copy = malloc (sizeof *copy)) == NULL)
+		return NULL;
+	*copy = *info;
+	copy->file = file_reopen (info->file);
+	return copy;
+}
+
+/* Copy supplemental page table from src to dst.
+ * Pages that have been brought in are shared copy-on-write rather
+ * than copied; see vm_handle_wp().  Pages not yet brought in stay
+ * that way in DST. */
 bool
 supplemental_page_table_copy (struct supplemental_page_table *dst, struct supplemental_page_table *src) {
 	struct hash_iterator iter;
@@ -256,26 +954,33 @@ supplemental_page_table_copy (struct supplemental_page_table *dst, struct supple
 	while (hash_next (&iter)) {
 		struct page *parent_page = hash_entry (hash_cur (&iter), struct page, hash_elem);
 		if (parent_page->operations->type == VM_UNINIT) {
-			struct necessary_info *parent_info = parent_page->uninit.aux;
-			struct necessary_info *child_info = malloc(sizeof (struct necessary_info));
-			child_info->file = file_reopen (parent_info->file);
-			child_info->ofs = parent_info->ofs;
-			child_info->page_read_bytes = parent_info->page_read_bytes;
-			child_info->page_zero_bytes = parent_info->page_zero_bytes;
-			vm_alloc_page_with_initializer (parent_page->uninit.type, parent_page->va, parent_page->writable,
-											parent_page->uninit.page_initializer, child_info);
-			vm_claim_page (parent_page->va);
+			struct necessary_info *child_info = necessary_info_copy (parent_page->uninit.aux);
+			if (parent_page->uninit.aux != NULL && child_info == NULL)
+				return false;
+			if (!vm_alloc_page_with_initializer (parent_page->uninit.type, parent_page->va,
+						parent_page->writable, parent_page->uninit.init, child_info))
+				return false;
 		}
 		else {
-			vm_alloc_page (parent_page->uninit.type, parent_page->va, parent_page->writable);
-			vm_claim_page (parent_page->va);
-			struct page *child_page = spt_find_page (dst, parent_page->va);
-			ASSERT (parent_page	->frame != NULL);
-			memcpy (child_page->frame->kva, parent_page->frame->kva, PGSIZE);
+			struct page *child_page = slab_alloc (page_slab);
+			if (child_page == NULL)
+				return false;
+			*child_page = *parent_page;
+			child_page->owner = thread_current ();
+			child_page->frame = NULL;
+			if (VM_TYPE (parent_page->operations->type) == VM_FILE) {
+				child_page->uninit.aux = necessary_info_copy (parent_page->uninit.aux);
+				if (child_page->uninit.aux == NULL) {
+					slab_free (page_slab, child_page);
+					return false;
+				}
+			}
+			if (!spt_share_page (child_page, parent_page)) {
+				slab_free (page_slab, child_page);
+				return false;
+			}
+			spt_insert_page (dst, child_page);
 		}
-		// struct page *child_page = spt_find_page (dst, parent_page->va);
-		// ASSERT (parent_page->frame != NULL);
-		// memcpy (child_page->frame->kva, parent_page->frame->kva, PGSIZE);
 	}
 	return true;
 }
@@ -293,8 +998,45 @@ supplemental_page_table_kill (struct supplemental_page_table *spt) {
 
 	while (hash_next (&iter)) {
 		struct page *page = hash_entry (hash_cur (&iter), struct page, hash_elem);
+		struct frame *frame;
+
+		/* Keep the zero page from being freed with the page table. */
+		if (page->zero_mapped) {
+			if (page->owner->pml4 != NULL)
+				pml4_clear_page (page->owner->pml4, page->va);
+			page->zero_mapped = false;
+		}
+
+		/* Unmap the frame, so that it is not freed along with the
+		 * page table, and free it here unless it is still shared. */
+		lock_acquire (&frame_lock);
+		frame_wait_evicted (page);
+		frame = page->frame;
+		if (frame != NULL) {
+			if (page->owner->pml4 != NULL)
+				pml4_clear_page (page->owner->pml4, page->va);
+			frame_unmap (frame, page);
+			if (frame->ref_cnt == 0)
+				frame_list_remove (frame);
+			else
+				frame = NULL;
+		}
+		lock_release (&frame_lock);
+		if (frame != NULL)
+			frame_free (frame);
+
 		destroy (page);
 		// hash_delete (&spt->hash_for_spt, &page->hash_elem);
 	}
 	hash_init (&spt->hash_for_spt, hash_hash_func_for_spt, hash_less_func_for_spt, NULL);
 }
+
+/* Prints statistics about page faults. */
+void
+vm_print_stats (void) {
+	printf ("VM: %"PRIu64" file page faults, "
+			"%"PRIu64" more pages brought in around them\n",
+			file_fault_cnt, fault_around_cnt);
+	printf ("VM: %"PRIu64" executable pages mapped from shared frames, "
+			"%zu frames shared now\n", share_hit_cnt, share_frame_cnt);
+}
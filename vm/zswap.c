@@ -0,0 +1,201 @@
+/* zswap.c: Compressed cache in front of the swap disk. */
+
+#include "vm/zswap.h"
+#include <inttypes.h>
+#include <list.h>
+#include <lz.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A page bound for a swap slot is first compressed and kept in
+ * kernel memory, and is written to the slot on disk only when it
+ * has to make room for newer pages, oldest first.  Swapping a page
+ * back in looks here before going to the disk.
+ *
+ * The cache is keyed by swap slot, so a page in it still owns its
+ * slot, and the rest of the swap code need not know where the
+ * contents are.  Slots are reference counted by anon.c, which calls
+ * zswap_invalidate() when the last reference goes away. */
+
+/* Pages that do not compress to this size or smaller go straight
+ * to disk: they would cost almost as much memory as they save. */
+#define MAX_COMPRESSED (PGSIZE * 3 / 4)
+
+#define PAGE_SECTOR_CNT (PGSIZE / DISK_SECTOR_SIZE)
+
+/* A compressed page. */
+struct zentry {
+	struct list_elem lru_elem;  /* Element in lru. */
+	size_t slot;                /* Swap slot it stands for. */
+	size_t size;                /* Size of DATA in bytes. */
+	uint8_t data[];             /* Compressed contents. */
+};
+
+size_t zswap_limit = ZSWAP_DEFAULT_LIMIT;
+
+static struct disk *swap_disk;
+
+static struct lock zswap_lock;  /* Protects everything below. */
+static struct zentry **entries; /* Entry for each slot, or null. */
+static struct list lru;         /* Entries, least recently used first. */
+static size_t used;             /* Bytes of compressed data held. */
+
+/* Buffers, each one page. */
+static uint8_t *compress_buf;   /* Output of lz_compress(). */
+static uint8_t *writeback_buf;  /* Decompressed page being written back. */
+static uint8_t lz_work[LZ_WORK_SIZE];
+
+/* Statistics. */
+static uint64_t store_cnt;      /* Pages stored. */
+static uint64_t reject_cnt;     /* Pages that did not compress well. */
+static uint64_t hit_cnt;        /* Loads served from memory. */
+static uint64_t miss_cnt;       /* Loads left to the disk. */
+static uint64_t writeback_cnt;  /* Pages written back to disk. */
+static uint64_t stored_bytes;   /* Compressed size of the pages stored. */
+
+/* Sets up the cache in front of SWAP_DISK, which has SLOT_CNT
+ * page-sized slots. */
+void
+zswap_init (struct disk *disk, size_t slot_cnt) {
+	swap_disk = disk;
+	lock_init (&zswap_lock);
+	list_init (&lru);
+	entries = calloc (slot_cnt, sizeof *entries);
+	compress_buf = palloc_get_page (0);
+	writeback_buf = palloc_get_page (0);
+	if (entries == NULL || compress_buf == NULL || writeback_buf == NULL)
+		PANIC ("zswap_init: out of memory");
+}
+
+/* Frees entry E. */
+static void
+remove_entry (struct zentry *e) {
+	ASSERT (lock_held_by_current_thread (&zswap_lock));
+
+	list_remove (&e->lru_elem);
+	entries[e->slot] = NULL;
+	used -= e->size;
+	free (e);
+}
+
+/* Writes the least recently used entry back to its slot on disk,
+ * and frees it. */
+static void
+write_back_oldest (void) {
+	struct zentry *e = list_entry (list_front (&lru), struct zentry, lru_elem);
+	const void *buf = writeback_buf;
+
+	if (lz_decompress (e->data, e->size, writeback_buf, PGSIZE) != PGSIZE)
+		PANIC ("zswap: corrupt entry for slot %zu", e->slot);
+	disk_writev (swap_disk, e->slot * PAGE_SECTOR_CNT, &buf, 1,
+			PAGE_SECTOR_CNT);
+	writeback_cnt++;
+	remove_entry (e);
+}
+
+/* Compresses PAGE into the cache as the contents of swap slot SLOT,
+ * writing older entries back to disk as needed to stay within
+ * zswap_limit.  Returns false if PAGE does not compress well
+ * enough, or there is no memory, in which case the caller must
+ * write PAGE to disk itself. */
+bool
+zswap_store (size_t slot, const void *page) {
+	struct zentry *e = NULL;
+	size_t size;
+
+	if (zswap_limit == 0)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	ASSERT (entries[slot] == NULL);
+	size = lz_compress (page, PGSIZE, compress_buf, MAX_COMPRESSED, lz_work);
+	if (size != 0 && size <= zswap_limit) {
+		while (used + size > zswap_limit)
+			write_back_oldest ();
+		e = malloc (sizeof *e + size);
+	}
+	if (e == NULL) {
+		reject_cnt++;
+		lock_release (&zswap_lock);
+		return false;
+	}
+
+	e->slot = slot;
+	e->size = size;
+	memcpy (e->data, compress_buf, size);
+	entries[slot] = e;
+	list_push_back (&lru, &e->lru_elem);
+	used += size;
+	store_cnt++;
+	stored_bytes += size;
+	lock_release (&zswap_lock);
+	return true;
+}
+
+/* Decompresses the contents of swap slot SLOT into PAGE, if they
+ * are in the cache.  Returns false if they are not, in which case
+ * they are on disk.  The entry stays until zswap_invalidate(), since
+ * other pages may share the slot. */
+bool
+zswap_load (size_t slot, void *page) {
+	struct zentry *e;
+
+	lock_acquire (&zswap_lock);
+	e = entries[slot];
+	if (e == NULL) {
+		miss_cnt++;
+		lock_release (&zswap_lock);
+		return false;
+	}
+	if (lz_decompress (e->data, e->size, page, PGSIZE) != PGSIZE)
+		PANIC ("zswap: corrupt entry for slot %zu", slot);
+	list_remove (&e->lru_elem);
+	list_push_back (&lru, &e->lru_elem);
+	hit_cnt++;
+	lock_release (&zswap_lock);
+	return true;
+}
+
+/* Returns true if the contents of swap slot SLOT are in the
+ * cache. */
+bool
+zswap_contains (size_t slot) {
+	bool found;
+
+	lock_acquire (&zswap_lock);
+	found = entries[slot] != NULL;
+	lock_release (&zswap_lock);
+	return found;
+}
+
+/* Drops the contents of swap slot SLOT, which is being freed, from
+ * the cache. */
+void
+zswap_invalidate (size_t slot) {
+	lock_acquire (&zswap_lock);
+	if (entries[slot] != NULL)
+		remove_entry (entries[slot]);
+	lock_release (&zswap_lock);
+}
+
+/* Prints statistics for the cache. */
+void
+zswap_print_stats (void) {
+	uint64_t loads = hit_cnt + miss_cnt;
+	uint64_t ratio = stored_bytes ? store_cnt * PGSIZE * 100 / stored_bytes : 0;
+
+	printf ("Zswap: %"PRIu64" stored, %"PRIu64" rejected, "
+			"%"PRIu64" written back, %"PRIu64"%% hit rate, "
+			"%"PRIu64".%02"PRIu64" compression ratio, "
+			"%zu of %zu bytes used by %zu pages\n",
+			store_cnt, reject_cnt, writeback_cnt,
+			loads ? hit_cnt * 100 / loads : 0,
+			ratio / 100, ratio % 100,
+			used, zswap_limit, list_size (&lru));
+}